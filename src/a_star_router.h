@@ -0,0 +1,183 @@
+#pragma once
+
+#include "dijkstra_router.h"
+#include "geo.h"
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Goal-directed search: the potential of a vertex is the great-circle distance to the target
+// divided by the fastest straight-line speed any edge of the graph achieves, so it never
+// overestimates the remaining weight.
+template <typename Weight>
+class AStarRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    AStarRouter(const Graph& graph, std::vector<geo::Coordinates> vertex_coordinates);
+
+    // Edges set in mask are skipped, the potential stays admissible since they can only make routes longer
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr,
+                                        const EdgeMask* mask = nullptr) const;
+
+    // Straight-line distance covered per unit of weight, zero disables the potential
+    double GetMaxSpeed() const {
+        return max_speed_;
+    }
+
+private:
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr EdgeId NO_EDGE = detail::NO_EDGE;
+
+    struct Scratch {
+        detail::SearchScratch<Weight> search;
+        std::vector<Weight> potential;
+        std::vector<uint32_t> potential_stamp;
+    };
+
+    static Scratch& GetScratch() {
+        static thread_local Scratch scratch;
+        return scratch;
+    }
+
+    Weight Potential(Scratch& scratch, VertexId vertex, VertexId to) const;
+    // Great-circle distance in meters, zero for vertices at the same place
+    double GetDistance(VertexId from, VertexId to) const {
+        return geo::ChordToDistance(geo::ComputeSquaredChord(vertex_vectors_.Get(from), vertex_vectors_.Get(to)));
+    }
+
+    const Graph& graph_;
+    geo::UnitVectors vertex_vectors_;
+    double max_speed_ = 0;
+};
+
+template <typename Weight>
+AStarRouter<Weight>::AStarRouter(const Graph& graph, std::vector<geo::Coordinates> vertex_coordinates)
+    : graph_(graph)
+{
+    if (!graph_.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen before routing");
+    }
+    if (vertex_coordinates.size() != graph_.GetVertexCount()) {
+        throw std::invalid_argument("Every vertex needs coordinates");
+    }
+    vertex_vectors_.Reserve(vertex_coordinates.size());
+    for (const auto& point : vertex_coordinates) {
+        vertex_vectors_.Add(point);
+    }
+
+    for (const auto& edge : graph_.GetEdges()) {
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        if (vertex_coordinates[edge.from] == vertex_coordinates[edge.to]) {
+            continue;
+        }
+        const double distance = GetDistance(edge.from, edge.to);
+        if (!(ZERO_WEIGHT < edge.weight)) {
+            // An instant edge between distinct places admits no finite speed bound
+            max_speed_ = 0;
+            return;
+        }
+        max_speed_ = std::max(max_speed_, distance / static_cast<double>(edge.weight));
+    }
+}
+
+template <typename Weight>
+Weight AStarRouter<Weight>::Potential(Scratch& scratch, VertexId vertex, VertexId to) const {
+    if (scratch.potential_stamp[vertex] == scratch.search.epoch) {
+        return scratch.potential[vertex];
+    }
+    Weight potential = ZERO_WEIGHT;
+    if (max_speed_ > 0) {
+        potential = static_cast<Weight>(GetDistance(vertex, to) / max_speed_);
+    }
+    scratch.potential_stamp[vertex] = scratch.search.epoch;
+    scratch.potential[vertex] = potential;
+    return potential;
+}
+
+template <typename Weight>
+std::optional<typename AStarRouter<Weight>::RouteInfo> AStarRouter<Weight>::BuildRoute(VertexId from, VertexId to,
+                                                                                       SearchStats* stats,
+                                                                                       const EdgeMask* mask) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    auto& scratch = GetScratch();
+    auto& search = scratch.search;
+    search.Prepare(vertex_count);
+    if (scratch.potential_stamp.size() < vertex_count) {
+        scratch.potential.resize(vertex_count);
+        scratch.potential_stamp.resize(vertex_count, 0);
+    }
+    if (search.epoch == 1) {
+        std::fill(scratch.potential_stamp.begin(), scratch.potential_stamp.end(), 0);
+    }
+
+    // The heap is keyed by weight plus potential, distance keeps the plain weight
+    const auto relax = [&](VertexId vertex, Weight weight, EdgeId edge_id) {
+        if (search.IsReached(vertex) && !(weight < search.distance[vertex])) {
+            return;
+        }
+        search.stamp[vertex] = search.epoch;
+        search.distance[vertex] = weight;
+        search.prev_edge[vertex] = edge_id;
+        search.heap.push_back({weight + Potential(scratch, vertex, to), vertex});
+        std::push_heap(search.heap.begin(), search.heap.end(), std::greater<std::pair<Weight, VertexId>>{});
+    };
+
+    relax(from, ZERO_WEIGHT, NO_EDGE);
+    size_t settled = 0;
+    bool found = false;
+    while (!search.heap.empty()) {
+        const auto [key, vertex] = search.PopMin();
+        const Weight weight = search.distance[vertex];
+        if (key > weight + Potential(scratch, vertex, to)) {
+            continue;
+        }
+        ++settled;
+        if (vertex == to) {
+            found = true;
+            break;
+        }
+        for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+            if (!IsMasked(mask, arc.edge_id)) {
+                relax(arc.to, weight + arc.weight, arc.edge_id);
+            }
+        }
+    }
+
+    if (stats) {
+        stats->settled_vertices = settled;
+    }
+    if (!found) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = search.prev_edge[to]; edge_id != NO_EDGE;
+         edge_id = search.prev_edge[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{search.distance[to], std::move(edges)};
+}
+
+}  // namespace graph
@@ -0,0 +1,424 @@
+#pragma once
+
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "router.h"
+#include "transport_router.pb.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Contracts the graph once and answers queries with a bidirectional upward search.
+// Arc ids below the edge count at contraction time are the graph's own edges, the rest are shortcuts;
+// edges appended to the graph later are not part of the hierarchy.
+template <typename Weight>
+class ContractionHierarchy {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+    using ArcId = size_t;
+
+    struct Shortcut {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        ArcId first;
+        ArcId second;
+    };
+
+    explicit ContractionHierarchy(const Graph& graph);
+    ContractionHierarchy(const transport_router_serialize::ContractionHierarchyDataBase& db, const Graph& graph)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , edge_count_(graph.GetEdgeCount())
+    {
+        rank_.assign(db.rank().begin(), db.rank().end());
+        if (rank_.size() != vertex_count_) {
+            throw std::invalid_argument("Contraction hierarchy does not match the graph");
+        }
+        shortcuts_.reserve(db.shortcuts_size());
+        for (const auto& shortcut : db.shortcuts()) {
+            const Shortcut loaded{static_cast<VertexId>(shortcut.from()), static_cast<VertexId>(shortcut.to()),
+                                  shortcut.weight(), static_cast<ArcId>(shortcut.first()),
+                                  static_cast<ArcId>(shortcut.second())};
+            // A shortcut is made of older arcs only, which also keeps unpacking from looping.
+            // Negative ids of a damaged base turn into huge ones and are rejected as well.
+            const ArcId arc = edge_count_ + shortcuts_.size();
+            if (loaded.from >= vertex_count_ || loaded.to >= vertex_count_ || loaded.first >= arc || loaded.second >= arc
+                || !(loaded.weight >= ZERO_WEIGHT) || ArcFrom(loaded.first) != loaded.from || ArcTo(loaded.second) != loaded.to
+                || ArcTo(loaded.first) != ArcFrom(loaded.second)) {
+                throw std::invalid_argument("Contraction hierarchy does not match the graph");
+            }
+            shortcuts_.push_back(loaded);
+        }
+        BuildSearchGraph();
+    }
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    const std::vector<uint32_t>& GetRanks() const {
+        return rank_;
+    }
+    const std::vector<Shortcut>& GetShortcuts() const {
+        return shortcuts_;
+    }
+
+private:
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr ArcId NO_ARC = detail::NO_EDGE;
+    // Witness searches give up after this many settled vertices and keep the shortcut
+    static constexpr size_t WITNESS_SETTLED_LIMIT = 256;
+
+    struct SearchArc {
+        VertexId vertex;
+        Weight weight;
+        ArcId arc;
+    };
+
+    struct Scratch {
+        detail::SearchScratch<Weight> forward;
+        detail::SearchScratch<Weight> backward;
+    };
+
+    static Scratch& GetScratch() {
+        static thread_local Scratch scratch;
+        return scratch;
+    }
+
+    // Adjacency of the not yet contracted part of the graph, used only while building
+    struct Contraction {
+        std::vector<std::vector<std::pair<VertexId, ArcId>>> out;
+        std::vector<std::vector<std::pair<VertexId, ArcId>>> in;
+        std::vector<bool> contracted;
+        std::vector<int> contracted_neighbours;
+        detail::SearchScratch<Weight> witness;
+    };
+
+    VertexId ArcFrom(ArcId arc) const {
+        return arc < edge_count_ ? graph_.GetEdge(arc).from : shortcuts_[arc - edge_count_].from;
+    }
+    VertexId ArcTo(ArcId arc) const {
+        return arc < edge_count_ ? graph_.GetEdge(arc).to : shortcuts_[arc - edge_count_].to;
+    }
+    Weight ArcWeight(ArcId arc) const {
+        return arc < edge_count_ ? graph_.GetEdge(arc).weight : shortcuts_[arc - edge_count_].weight;
+    }
+
+    void AddArc(Contraction& state, ArcId arc) const;
+    void RemoveVertex(Contraction& state, VertexId vertex) const;
+    void RunWitnessSearch(Contraction& state, VertexId from, VertexId via, Weight limit) const;
+    int ContractVertex(Contraction& state, VertexId vertex, bool simulate);
+    int Priority(Contraction& state, VertexId vertex);
+    void BuildSearchGraph();
+    void UnpackArc(ArcId arc, std::vector<EdgeId>& edges) const;
+
+    const Graph& graph_;
+    size_t vertex_count_;
+    size_t edge_count_;
+    std::vector<uint32_t> rank_;
+    std::vector<Shortcut> shortcuts_;
+
+    std::vector<size_t> up_offsets_;
+    std::vector<SearchArc> up_arcs_;
+    std::vector<size_t> down_offsets_;
+    std::vector<SearchArc> down_arcs_;
+};
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , edge_count_(graph.GetEdgeCount())
+{
+    const size_t vertex_count = vertex_count_;
+    Contraction state;
+    state.out.resize(vertex_count);
+    state.in.resize(vertex_count);
+    state.contracted.assign(vertex_count, false);
+    state.contracted_neighbours.assign(vertex_count, 0);
+
+    for (ArcId arc = 0; arc < edge_count_; ++arc) {
+        const auto& edge = graph_.GetEdge(arc);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        if (edge.from != edge.to) {
+            AddArc(state, arc);
+        }
+    }
+
+    using QueueItem = std::pair<int, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        queue.push({Priority(state, vertex), vertex});
+    }
+
+    rank_.assign(vertex_count, 0);
+    uint32_t next_rank = 0;
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        if (state.contracted[vertex]) {
+            continue;
+        }
+        // Lazy update: the stored priority may be outdated by earlier contractions
+        const int priority = Priority(state, vertex);
+        if (!queue.empty() && priority > queue.top().first) {
+            queue.push({priority, vertex});
+            continue;
+        }
+
+        ContractVertex(state, vertex, false);
+        rank_[vertex] = next_rank++;
+        for (const auto& [neighbour, arc] : state.out[vertex]) {
+            ++state.contracted_neighbours[neighbour];
+        }
+        for (const auto& [neighbour, arc] : state.in[vertex]) {
+            ++state.contracted_neighbours[neighbour];
+        }
+        RemoveVertex(state, vertex);
+    }
+
+    BuildSearchGraph();
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::AddArc(Contraction& state, ArcId arc) const {
+    const VertexId from = ArcFrom(arc);
+    const VertexId to = ArcTo(arc);
+    // Parallel arcs are useless for the search, keep only the lightest one per vertex pair
+    for (auto& [vertex, existing] : state.out[from]) {
+        if (vertex != to) {
+            continue;
+        }
+        if (ArcWeight(arc) < ArcWeight(existing)) {
+            for (auto& [in_vertex, in_existing] : state.in[to]) {
+                if (in_vertex == from) {
+                    in_existing = arc;
+                }
+            }
+            existing = arc;
+        }
+        return;
+    }
+    state.out[from].push_back({to, arc});
+    state.in[to].push_back({from, arc});
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::RemoveVertex(Contraction& state, VertexId vertex) const {
+    state.contracted[vertex] = true;
+    const auto erase_vertex = [vertex](std::vector<std::pair<VertexId, ArcId>>& list) {
+        list.erase(std::remove_if(list.begin(), list.end(), [vertex](const auto& item) {
+                       return item.first == vertex;
+                   }),
+                   list.end());
+    };
+    for (const auto& [neighbour, arc] : state.out[vertex]) {
+        erase_vertex(state.in[neighbour]);
+    }
+    for (const auto& [neighbour, arc] : state.in[vertex]) {
+        erase_vertex(state.out[neighbour]);
+    }
+}
+
+// Reached vertices get an upper bound of the route that avoids the vertex being contracted
+template <typename Weight>
+void ContractionHierarchy<Weight>::RunWitnessSearch(Contraction& state, VertexId from, VertexId via,
+                                                    Weight limit) const {
+    auto& witness = state.witness;
+    witness.Prepare(vertex_count_);
+    witness.Relax(from, ZERO_WEIGHT, NO_ARC);
+
+    size_t settled = 0;
+    while (!witness.heap.empty() && settled < WITNESS_SETTLED_LIMIT) {
+        const auto [weight, vertex] = witness.PopMin();
+        if (weight > witness.distance[vertex]) {
+            continue;
+        }
+        if (limit < weight) {
+            return;
+        }
+        ++settled;
+        for (const auto& [next, arc] : state.out[vertex]) {
+            if (next != via) {
+                witness.Relax(next, weight + ArcWeight(arc), arc);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+int ContractionHierarchy<Weight>::ContractVertex(Contraction& state, VertexId vertex, bool simulate) {
+    int shortcut_count = 0;
+    // Shortcuts are collected first, adding them on the fly would change the lists being iterated
+    std::vector<Shortcut> added;
+    Weight max_out_weight = ZERO_WEIGHT;
+    for (const auto& [to, out_arc] : state.out[vertex]) {
+        max_out_weight = std::max(max_out_weight, ArcWeight(out_arc));
+    }
+
+    for (const auto& [from, in_arc] : state.in[vertex]) {
+        RunWitnessSearch(state, from, vertex, ArcWeight(in_arc) + max_out_weight);
+        for (const auto& [to, out_arc] : state.out[vertex]) {
+            if (from == to) {
+                continue;
+            }
+            const Weight weight = ArcWeight(in_arc) + ArcWeight(out_arc);
+            if (state.witness.IsReached(to) && !(weight < state.witness.distance[to])) {
+                continue;
+            }
+            ++shortcut_count;
+            if (!simulate) {
+                added.push_back({from, to, weight, in_arc, out_arc});
+            }
+        }
+    }
+    for (const Shortcut& shortcut : added) {
+        shortcuts_.push_back(shortcut);
+        AddArc(state, edge_count_ + shortcuts_.size() - 1);
+    }
+    return shortcut_count;
+}
+
+template <typename Weight>
+int ContractionHierarchy<Weight>::Priority(Contraction& state, VertexId vertex) {
+    const int edge_difference = ContractVertex(state, vertex, true)
+                                - static_cast<int>(state.in[vertex].size() + state.out[vertex].size());
+    return edge_difference + state.contracted_neighbours[vertex];
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::BuildSearchGraph() {
+    const size_t vertex_count = vertex_count_;
+    const size_t arc_count = edge_count_ + shortcuts_.size();
+
+    up_offsets_.assign(vertex_count + 1, 0);
+    down_offsets_.assign(vertex_count + 1, 0);
+    for (ArcId arc = 0; arc < arc_count; ++arc) {
+        const VertexId from = ArcFrom(arc);
+        const VertexId to = ArcTo(arc);
+        if (rank_[from] < rank_[to]) {
+            ++up_offsets_[from + 1];
+        }
+        else if (rank_[to] < rank_[from]) {
+            ++down_offsets_[to + 1];
+        }
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        up_offsets_[vertex + 1] += up_offsets_[vertex];
+        down_offsets_[vertex + 1] += down_offsets_[vertex];
+    }
+
+    up_arcs_.resize(up_offsets_.back());
+    down_arcs_.resize(down_offsets_.back());
+    std::vector<size_t> up_fill(up_offsets_.begin(), up_offsets_.end() - 1);
+    std::vector<size_t> down_fill(down_offsets_.begin(), down_offsets_.end() - 1);
+    for (ArcId arc = 0; arc < arc_count; ++arc) {
+        const VertexId from = ArcFrom(arc);
+        const VertexId to = ArcTo(arc);
+        if (rank_[from] < rank_[to]) {
+            up_arcs_[up_fill[from]++] = {to, ArcWeight(arc), arc};
+        }
+        else if (rank_[to] < rank_[from]) {
+            down_arcs_[down_fill[to]++] = {from, ArcWeight(arc), arc};
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackArc(ArcId arc, std::vector<EdgeId>& edges) const {
+    std::vector<ArcId> stack{arc};
+    while (!stack.empty()) {
+        const ArcId current = stack.back();
+        stack.pop_back();
+        if (current < edge_count_) {
+            edges.push_back(current);
+            continue;
+        }
+        const Shortcut& shortcut = shortcuts_[current - edge_count_];
+        stack.push_back(shortcut.second);
+        stack.push_back(shortcut.first);
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchy<Weight>::RouteInfo> ContractionHierarchy<Weight>::BuildRoute(
+    VertexId from, VertexId to) const {
+    const size_t vertex_count = vertex_count_;
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    auto& [forward, backward] = GetScratch();
+    forward.Prepare(vertex_count);
+    backward.Prepare(vertex_count);
+    forward.Relax(from, ZERO_WEIGHT, NO_ARC);
+    backward.Relax(to, ZERO_WEIGHT, NO_ARC);
+
+    std::optional<Weight> best;
+    VertexId meeting = from;
+
+    const auto step = [&best, &meeting](detail::SearchScratch<Weight>& side, const detail::SearchScratch<Weight>& other,
+                                        const std::vector<size_t>& offsets, const std::vector<SearchArc>& arcs) {
+        const auto [weight, vertex] = side.PopMin();
+        if (weight > side.distance[vertex]) {
+            return;
+        }
+        if (best && !(weight < *best)) {
+            side.heap.clear();
+            return;
+        }
+        if (other.IsReached(vertex)) {
+            const Weight candidate = weight + other.distance[vertex];
+            if (!best || candidate < *best) {
+                best = candidate;
+                meeting = vertex;
+            }
+        }
+        for (size_t i = offsets[vertex]; i < offsets[vertex + 1]; ++i) {
+            side.Relax(arcs[i].vertex, weight + arcs[i].weight, arcs[i].arc);
+        }
+    };
+
+    while (!forward.heap.empty() || !backward.heap.empty()) {
+        if (!forward.heap.empty()) {
+            step(forward, backward, up_offsets_, up_arcs_);
+        }
+        if (!backward.heap.empty()) {
+            step(backward, forward, down_offsets_, down_arcs_);
+        }
+    }
+
+    if (!best) {
+        return std::nullopt;
+    }
+
+    std::vector<ArcId> forward_arcs;
+    for (ArcId arc = forward.prev_edge[meeting]; arc != NO_ARC; arc = forward.prev_edge[ArcFrom(arc)]) {
+        forward_arcs.push_back(arc);
+    }
+    std::reverse(forward_arcs.begin(), forward_arcs.end());
+
+    std::vector<EdgeId> edges;
+    for (const ArcId arc : forward_arcs) {
+        UnpackArc(arc, edges);
+    }
+    for (ArcId arc = backward.prev_edge[meeting]; arc != NO_ARC; arc = backward.prev_edge[ArcTo(arc)]) {
+        UnpackArc(arc, edges);
+    }
+
+    return RouteInfo{*best, std::move(edges)};
+}
+
+}  // namespace graph
@@ -0,0 +1,349 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+namespace detail {
+
+inline constexpr EdgeId NO_EDGE = static_cast<EdgeId>(-1);
+
+// Search state reused between queries of one thread, entries are valid only when stamp == epoch
+template <typename Weight>
+struct SearchScratch {
+    std::vector<Weight> distance;
+    std::vector<EdgeId> prev_edge;
+    std::vector<uint32_t> stamp;
+    std::vector<std::pair<Weight, VertexId>> heap;
+    uint32_t epoch = 0;
+
+    void Prepare(size_t vertex_count) {
+        if (stamp.size() < vertex_count) {
+            distance.resize(vertex_count);
+            prev_edge.resize(vertex_count);
+            stamp.resize(vertex_count, 0);
+        }
+        heap.clear();
+        if (++epoch == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+    }
+
+    bool IsReached(VertexId vertex) const {
+        return stamp[vertex] == epoch;
+    }
+
+    // Returns false when the vertex already has a route not worse than the candidate
+    bool Relax(VertexId vertex, Weight weight, EdgeId edge_id) {
+        if (IsReached(vertex) && !(weight < distance[vertex])) {
+            return false;
+        }
+        stamp[vertex] = epoch;
+        distance[vertex] = weight;
+        prev_edge[vertex] = edge_id;
+        heap.push_back({weight, vertex});
+        std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<Weight, VertexId>>{});
+        return true;
+    }
+
+    std::pair<Weight, VertexId> PopMin() {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<Weight, VertexId>>{});
+        const auto top = heap.back();
+        heap.pop_back();
+        return top;
+    }
+};
+
+}  // namespace detail
+
+struct SearchStats {
+    size_t settled_vertices = 0;
+};
+
+// Vertex joined to a virtual endpoint of a search by a link of the given weight
+template <typename Weight>
+struct EndpointLink {
+    VertexId vertex;
+    Weight weight;
+};
+
+// Answers every query with a single-source search instead of keeping the V x V table of Router.
+// Needs a frozen graph.
+template <typename Weight>
+class DijkstraRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+    using Link = EndpointLink<Weight>;
+
+    // Route between two virtual vertices, source and target are the indices of the links it uses.
+    // The weight includes both links, the edges run from the source's vertex to the target's one.
+    struct EndpointRouteInfo {
+        Weight weight;
+        size_t source;
+        size_t target;
+        std::vector<EdgeId> edges;
+    };
+
+    explicit DijkstraRouter(const Graph& graph);
+
+    // Edges set in mask are skipped by every search
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr,
+                                        const EdgeMask* mask = nullptr) const;
+
+    // A single search from a virtual vertex linked to the sources to one linked from the targets.
+    // Nothing is added to the graph, so concurrent searches stay safe.
+    std::optional<EndpointRouteInfo> BuildRoute(const std::vector<Link>& sources, const std::vector<Link>& targets,
+                                                const EdgeMask* mask = nullptr) const;
+
+    // Weights of the shortest routes from one vertex to each of targets, taken from a single search tree
+    std::vector<std::optional<Weight>> ComputeWeights(VertexId from, const std::vector<VertexId>& targets,
+                                                      const EdgeMask* mask = nullptr) const;
+
+    // Vertices whose shortest route from the vertex weighs at most max_weight, in the order of weight
+    std::vector<std::pair<VertexId, Weight>> ComputeReachable(VertexId from, Weight max_weight,
+                                                              const EdgeMask* mask = nullptr) const;
+
+private:
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr EdgeId NO_EDGE = detail::NO_EDGE;
+
+    static detail::SearchScratch<Weight>& GetScratch() {
+        static thread_local detail::SearchScratch<Weight> scratch;
+        return scratch;
+    }
+
+    const Graph& graph_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph)
+    : graph_(graph)
+{
+    if (!graph_.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen before routing");
+    }
+    for (const auto& edge : graph_.GetEdges()) {
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to,
+                                                                                             SearchStats* stats,
+                                                                                             const EdgeMask* mask) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    auto& scratch = GetScratch();
+    scratch.Prepare(vertex_count);
+    scratch.Relax(from, ZERO_WEIGHT, NO_EDGE);
+
+    size_t settled = 0;
+    bool found = false;
+    while (!scratch.heap.empty()) {
+        const auto [weight, vertex] = scratch.PopMin();
+        if (weight > scratch.distance[vertex]) {
+            continue;
+        }
+        ++settled;
+        if (vertex == to) {
+            found = true;
+            break;
+        }
+
+        for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+            if (!IsMasked(mask, arc.edge_id)) {
+                scratch.Relax(arc.to, weight + arc.weight, arc.edge_id);
+            }
+        }
+    }
+
+    if (stats) {
+        stats->settled_vertices = settled;
+    }
+    if (!found) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = scratch.prev_edge[to]; edge_id != NO_EDGE;
+         edge_id = scratch.prev_edge[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{scratch.distance[to], std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::EndpointRouteInfo> DijkstraRouter<Weight>::BuildRoute(
+    const std::vector<Link>& sources, const std::vector<Link>& targets, const EdgeMask* mask) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    for (const auto& links : {&sources, &targets}) {
+        for (const Link& link : *links) {
+            if (link.vertex >= vertex_count) {
+                throw std::out_of_range("Vertex id is out of range");
+            }
+        }
+    }
+
+    auto& scratch = GetScratch();
+    scratch.Prepare(vertex_count);
+    for (const Link& link : sources) {
+        scratch.Relax(link.vertex, link.weight, NO_EDGE);
+    }
+
+    // Target links ordered by vertex, so the links of a settled vertex are found by a binary search
+    std::vector<std::pair<VertexId, size_t>> target_links;
+    target_links.reserve(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i) {
+        target_links.emplace_back(targets[i].vertex, i);
+    }
+    std::sort(target_links.begin(), target_links.end());
+
+    std::optional<Weight> best_weight;
+    size_t best_target = 0;
+    while (!scratch.heap.empty()) {
+        const auto [weight, vertex] = scratch.PopMin();
+        if (weight > scratch.distance[vertex]) {
+            continue;
+        }
+        // Links are not negative, so no vertex settled from now on gives a lighter route
+        if (best_weight && !(weight < *best_weight)) {
+            break;
+        }
+
+        for (auto it = std::lower_bound(target_links.begin(), target_links.end(), std::pair<VertexId, size_t>{vertex, 0});
+             it != target_links.end() && it->first == vertex; ++it) {
+            const Weight route_weight = weight + targets[it->second].weight;
+            if (!best_weight || route_weight < *best_weight) {
+                best_weight = route_weight;
+                best_target = it->second;
+            }
+        }
+
+        for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+            if (!IsMasked(mask, arc.edge_id)) {
+                scratch.Relax(arc.to, weight + arc.weight, arc.edge_id);
+            }
+        }
+    }
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    EndpointRouteInfo result{*best_weight, 0, best_target, {}};
+    VertexId first_vertex = targets[best_target].vertex;
+    for (EdgeId edge_id = scratch.prev_edge[first_vertex]; edge_id != NO_EDGE; edge_id = scratch.prev_edge[first_vertex]) {
+        result.edges.push_back(edge_id);
+        first_vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(result.edges.begin(), result.edges.end());
+    // The route starts at the lightest link of its first vertex
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (sources[i].vertex == first_vertex && !(scratch.distance[first_vertex] < sources[i].weight)) {
+            result.source = i;
+            break;
+        }
+    }
+    return result;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> DijkstraRouter<Weight>::ComputeWeights(VertexId from,
+                                                                          const std::vector<VertexId>& targets,
+                                                                          const EdgeMask* mask) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    for (const VertexId target : targets) {
+        if (target >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+    }
+
+    auto& scratch = GetScratch();
+    scratch.Prepare(vertex_count);
+    scratch.Relax(from, ZERO_WEIGHT, NO_EDGE);
+
+    // The search stops as soon as every distinct target is settled
+    std::vector<VertexId> pending(targets);
+    std::sort(pending.begin(), pending.end());
+    pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+    size_t pending_count = pending.size();
+
+    while (!scratch.heap.empty() && pending_count > 0) {
+        const auto [weight, vertex] = scratch.PopMin();
+        if (weight > scratch.distance[vertex]) {
+            continue;
+        }
+        if (std::binary_search(pending.begin(), pending.end(), vertex)) {
+            --pending_count;
+        }
+
+        for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+            if (!IsMasked(mask, arc.edge_id)) {
+                scratch.Relax(arc.to, weight + arc.weight, arc.edge_id);
+            }
+        }
+    }
+
+    std::vector<std::optional<Weight>> result;
+    result.reserve(targets.size());
+    for (const VertexId target : targets) {
+        result.push_back(scratch.IsReached(target) ? std::optional<Weight>(scratch.distance[target]) : std::nullopt);
+    }
+    return result;
+}
+
+template <typename Weight>
+std::vector<std::pair<VertexId, Weight>> DijkstraRouter<Weight>::ComputeReachable(VertexId from, Weight max_weight,
+                                                                                  const EdgeMask* mask) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    auto& scratch = GetScratch();
+    scratch.Prepare(vertex_count);
+    scratch.Relax(from, ZERO_WEIGHT, NO_EDGE);
+
+    std::vector<std::pair<VertexId, Weight>> result;
+    while (!scratch.heap.empty()) {
+        const auto [weight, vertex] = scratch.PopMin();
+        if (weight > scratch.distance[vertex]) {
+            continue;
+        }
+        result.emplace_back(vertex, weight);
+
+        // Vertices beyond the bound never enter the heap, so the search ends with the last one within it
+        for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+            if (!IsMasked(mask, arc.edge_id) && !(max_weight < weight + arc.weight)) {
+                scratch.Relax(arc.to, weight + arc.weight, arc.edge_id);
+            }
+        }
+    }
+    return result;
+}
+
+}  // namespace graph
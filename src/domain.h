@@ -1,11 +1,13 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
+#include <string_view>
 #include <set>
 #include <vector>
 #include <unordered_set>
 
 #include "geo.h"
+#include "name_arena.h"
 
 namespace domain {
 	struct Stop {
@@ -19,27 +21,36 @@ namespace domain {
 		}
 
 		bool operator==(const Stop& other) const {
-			return Stop_name == other.Stop_name;
+			return name_id == other.name_id;
 		}
 
-		std::string Stop_name;
-		geo::Coordinates coordinates;
+		// Views into the catalogue's NameArena
+		std::string_view Stop_name;
+		NameId name_id = NO_NAME;
+		// Position in TransportCatalogue::GetStops(), the coordinates are TransportCatalogue::GetStopCoordinates().Get(id)
+		uint32_t id = 0;
 	};
 
 
 	struct Bus {
 
 		bool operator==(const Bus& other) const {
-			return bus_name == other.bus_name;
+			return name_id == other.name_id;
 		}
 
-		std::string bus_name;
+		std::string_view bus_name;
+		NameId name_id = NO_NAME;
+		// Position in TransportCatalogue::GetRoutes()
+		uint32_t id = 0;
 
 		std::set <const Stop*> unique_stops;
 		std::vector <const Stop*> route;
 
+		// Filled by the catalogue whenever the route or one of its distances changes
 		double route_length = 0;
 		double curvature = 0.0;
+		int stop_count = 0;
+		int unique_stop_count = 0;
 		bool is_roundtrip = false;
 	};
 
@@ -1,6 +1,7 @@
 #define _USE_MATH_DEFINES
 #include "geo.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace geo {
@@ -13,6 +14,100 @@ double ComputeDistance(Coordinates from, Coordinates to) {
         * 6371000;
 }
 
+namespace {
+
+constexpr double EARTH_RADIUS = 6371000;
+
+}  // namespace
+
+CompactCoordinates ToCompact(Coordinates point) {
+    return {static_cast<int32_t>(std::lround(point.lat * MICRODEGREES_IN_DEGREE)),
+            static_cast<int32_t>(std::lround(point.lng * MICRODEGREES_IN_DEGREE))};
+}
+
+void CoordinateArray::Add(Coordinates point) {
+    if (compact_) {
+        compact_points_.push_back(ToCompact(point));
+    }
+    else {
+        points_.push_back(point);
+    }
+}
+
+void CoordinateArray::Add(CompactCoordinates point) {
+    if (compact_) {
+        compact_points_.push_back(point);
+    }
+    else {
+        points_.push_back(FromCompact(point));
+    }
+}
+
+void CoordinateArray::Reserve(size_t count) {
+    if (compact_) {
+        compact_points_.reserve(count);
+    }
+    else {
+        points_.reserve(count);
+    }
+}
+
+UnitVector ToUnitVector(Coordinates point) {
+    const double dr = M_PI / 180.0;
+    const double cos_lat = std::cos(point.lat * dr);
+    return {cos_lat * std::cos(point.lng * dr), cos_lat * std::sin(point.lng * dr), std::sin(point.lat * dr)};
+}
+
+double ChordToDistance(double squared_chord) {
+    // Rounding may push the half chord slightly above 1 for antipodes
+    return 2 * EARTH_RADIUS * std::asin(std::min(1.0, std::sqrt(squared_chord) / 2));
+}
+
+double DistanceToChord(double distance) {
+    const double chord = 2 * std::sin(std::min(distance / EARTH_RADIUS, M_PI) / 2);
+    return chord * chord;
+}
+
+void UnitVectors::Add(Coordinates point) {
+    const UnitVector vector = ToUnitVector(point);
+    x_.push_back(vector.x);
+    y_.push_back(vector.y);
+    z_.push_back(vector.z);
+}
+
+void UnitVectors::Reserve(size_t count) {
+    x_.reserve(count);
+    y_.reserve(count);
+    z_.reserve(count);
+}
+
+void UnitVectors::ComputeSquaredChords(const UnitVector& point, size_t first, size_t count, double* result) const {
+    const double* x = x_.data() + first;
+    const double* y = y_.data() + first;
+    const double* z = z_.data() + first;
+    for (size_t i = 0; i < count; ++i) {
+        const double dx = x[i] - point.x;
+        const double dy = y[i] - point.y;
+        const double dz = z[i] - point.z;
+        result[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+std::vector<double> UnitVectors::ComputeDistances(const uint32_t* from, const uint32_t* to, size_t count) const {
+    std::vector<double> result(count);
+    // Arcsines in a second pass, the first loop has no calls
+    for (size_t i = 0; i < count; ++i) {
+        const double dx = x_[from[i]] - x_[to[i]];
+        const double dy = y_[from[i]] - y_[to[i]];
+        const double dz = z_[from[i]] - z_[to[i]];
+        result[i] = dx * dx + dy * dy + dz * dz;
+    }
+    for (double& distance : result) {
+        distance = ChordToDistance(distance);
+    }
+    return result;
+}
+
 }  // namespace geo
 
 bool operator==(geo::Coordinates lhs, geo::Coordinates rhs) {
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 namespace geo {
 
 struct Coordinates {
@@ -16,4 +20,103 @@ struct Coordinates {
 
 double ComputeDistance(Coordinates from, Coordinates to);
 
+constexpr double MICRODEGREES_IN_DEGREE = 1e6;
+// Rounding to whole microdegrees moves a point by at most half a microdegree in latitude and
+// in longitude, that is no more than sqrt(2) * 0.5e-6 * pi / 180 * 6371000 = 0.0787 meters
+constexpr double MAX_COMPACT_ERROR = 0.0787;
+
+// Coordinates in whole microdegrees, half the size of Coordinates
+struct CompactCoordinates {
+    int32_t lat = 0;
+    int32_t lng = 0;
+};
+
+CompactCoordinates ToCompact(Coordinates point);
+
+inline Coordinates FromCompact(CompactCoordinates point) {
+    return {point.lat / MICRODEGREES_IN_DEGREE, point.lng / MICRODEGREES_IN_DEGREE};
+}
+
+// Coordinates of many points. A compact array rounds every point to whole microdegrees and keeps
+// CompactCoordinates, Get decodes them on the fly; otherwise the points are kept as they are.
+class CoordinateArray {
+public:
+    CoordinateArray() = default;
+    explicit CoordinateArray(bool compact)
+        : compact_(compact) {
+    }
+
+    void Add(Coordinates point);
+    void Add(CompactCoordinates point);
+    void Reserve(size_t count);
+
+    bool IsCompact() const {
+        return compact_;
+    }
+    size_t GetSize() const {
+        return compact_ ? compact_points_.size() : points_.size();
+    }
+    Coordinates Get(size_t index) const {
+        return compact_ ? FromCompact(compact_points_[index]) : points_[index];
+    }
+    // The stored microdegrees of a compact array
+    CompactCoordinates GetCompact(size_t index) const {
+        return compact_points_[index];
+    }
+
+private:
+    bool compact_ = false;
+    std::vector<Coordinates> points_;
+    std::vector<CompactCoordinates> compact_points_;
+};
+
+// Point on the unit sphere
+struct UnitVector {
+    double x = 0;
+    double y = 0;
+    double z = 0;
+};
+
+UnitVector ToUnitVector(Coordinates point);
+
+// Squared length of the chord between two points on the unit sphere, grows with the distance between them
+inline double ComputeSquaredChord(const UnitVector& from, const UnitVector& to) {
+    const double dx = from.x - to.x;
+    const double dy = from.y - to.y;
+    const double dz = from.z - to.z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// Great-circle distance in meters for a squared chord, the haversine formula in other terms:
+// unlike ComputeDistance it stays exact for points a few meters apart
+double ChordToDistance(double squared_chord);
+// Squared chord of a great-circle distance in meters, distances beyond half the circumference give 4
+double DistanceToChord(double distance);
+
+// Unit vectors of many points, one array per component. The sines and cosines of a point are
+// computed once when it is added, the batch kernels below are plain loops over the arrays
+// without branches or calls, which the compiler turns into SIMD code.
+class UnitVectors {
+public:
+    void Add(Coordinates point);
+    void Reserve(size_t count);
+
+    size_t GetSize() const {
+        return x_.size();
+    }
+    UnitVector Get(size_t index) const {
+        return {x_[index], y_[index], z_[index]};
+    }
+
+    // Squared chords from point to points first .. first + count - 1, written to result
+    void ComputeSquaredChords(const UnitVector& point, size_t first, size_t count, double* result) const;
+    // Great-circle distances in meters between points from[i] and to[i] for i < count
+    std::vector<double> ComputeDistances(const uint32_t* from, const uint32_t* to, size_t count) const;
+
+private:
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> z_;
+};
+
 }  // namespace geo
\ No newline at end of file
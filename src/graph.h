@@ -1,94 +1,229 @@
-#pragma once
-
-#include "ranges.h"
-
-#include <cstdlib>
-#include <string>
-#include <vector>
-
-namespace graph {
-
-using VertexId = size_t;
-using EdgeId = size_t;
-
-template <typename Weight>
-struct Edge {
-    VertexId from;
-    VertexId to;
-    Weight weight;
-    std::string_view bus_name{};
-    int span_count = 0;
-};
-
-template <typename Weight>
-class DirectedWeightedGraph {
-private:
-    using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
-
-public:
-    DirectedWeightedGraph(std::vector<Edge<Weight>>&& edges, std::vector<IncidenceList>&& lists);
-    explicit DirectedWeightedGraph(size_t vertex_count);
-    EdgeId AddEdge(const Edge<Weight>& edge);
-
-    size_t GetVertexCount() const;
-    size_t GetEdgeCount() const;
-    const Edge<Weight>& GetEdge(EdgeId edge_id) const;
-    IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
-
-    const std::vector<Edge<Weight>>& GetEdges() const;
-    const std::vector<IncidenceList>& GetIncidenceLists() const;
-private:
-    std::vector<Edge<Weight>> edges_;
-    std::vector<IncidenceList> incidence_lists_;
-};
-
-template <typename Weight>
-DirectedWeightedGraph<Weight>::DirectedWeightedGraph(std::vector<Edge<Weight>>&& edges, std::vector<IncidenceList>&& lists)
-    :edges_(std::move(edges)), incidence_lists_(std::move(lists))
-{
-
-}
-
-template <typename Weight>
-DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
-}
-
-template <typename Weight>
-EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
-    edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    incidence_lists_.at(edge.from).push_back(id);
-    return id;
-}
-
-template <typename Weight>
-size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
-}
-
-template <typename Weight>
-size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
-    return edges_.size();
-}
-
-template <typename Weight>
-const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
-    return edges_.at(edge_id);
-}
-
-template <typename Weight>
-typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
-DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
-}
-template<typename Weight>
-const std::vector<Edge<Weight>>& DirectedWeightedGraph<Weight>::GetEdges() const{
-    return edges_;
-}
-template<typename Weight>
-const std::vector<std::vector<EdgeId>>& DirectedWeightedGraph<Weight>::GetIncidenceLists() const{
-    return incidence_lists_;
-}
-}  // namespace graph
+#pragma once
+
+#include "name_arena.h"
+#include "ranges.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace graph {
+
+using VertexId = size_t;
+using EdgeId = size_t;
+
+template <typename Weight>
+struct Edge {
+    VertexId from;
+    VertexId to;
+    Weight weight;
+    // Name of the bus riding the edge, NO_NAME for waiting
+    domain::NameId bus_name_id = domain::NO_NAME;
+    int span_count = 0;
+};
+
+// Edges a search has to skip, one bit per EdgeId
+class EdgeMask {
+public:
+    EdgeMask() = default;
+    explicit EdgeMask(size_t edge_count)
+        : words_((edge_count + 63) / 64, 0) {
+    }
+
+    void Disable(EdgeId edge_id) {
+        if (!IsDisabled(edge_id)) {
+            words_.at(edge_id / 64) |= uint64_t{1} << (edge_id % 64);
+            ++disabled_count_;
+        }
+    }
+    bool IsDisabled(EdgeId edge_id) const {
+        return edge_id / 64 < words_.size() && (words_[edge_id / 64] >> (edge_id % 64)) & 1;
+    }
+    bool IsEmpty() const {
+        return disabled_count_ == 0;
+    }
+    // Grows the mask to cover edge_count edges, new edges are enabled
+    void Resize(size_t edge_count) {
+        words_.resize(std::max(words_.size(), (edge_count + 63) / 64), 0);
+    }
+
+private:
+    std::vector<uint64_t> words_;
+    size_t disabled_count_ = 0;
+};
+
+inline bool IsMasked(const EdgeMask* mask, EdgeId edge_id) {
+    return mask != nullptr && mask->IsDisabled(edge_id);
+}
+
+template <typename Weight>
+class DirectedWeightedGraph {
+private:
+    using IncidenceList = std::vector<EdgeId>;
+    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+
+public:
+    // Hot part of an edge as stored in the frozen graph, the rest stays in Edge
+    struct Arc {
+        Weight weight;
+        uint32_t to;
+        uint32_t edge_id;
+    };
+    using ArcsRange = ranges::Range<typename std::vector<Arc>::const_iterator>;
+
+    DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>>&& edges);
+    explicit DirectedWeightedGraph(size_t vertex_count);
+    EdgeId AddEdge(const Edge<Weight>& edge);
+
+    // Packs the incidence lists into one offsets array and one edge array sorted by source.
+    // A frozen graph accepts no more edges.
+    void Freeze();
+    bool IsFrozen() const;
+    // Appends edges and vertices to a frozen graph, ids of the present edges stay the same
+    void Extend(size_t vertex_count, const std::vector<Edge<Weight>>& edges);
+
+    size_t GetVertexCount() const;
+    size_t GetEdgeCount() const;
+    const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+    IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    // Outgoing edges of a frozen graph laid out contiguously
+    ArcsRange GetOutgoingArcs(VertexId vertex) const;
+
+    const std::vector<Edge<Weight>>& GetEdges() const;
+private:
+    size_t vertex_count_ = 0;
+    std::vector<Edge<Weight>> edges_;
+    std::vector<IncidenceList> incidence_lists_;
+
+    std::vector<size_t> offsets_;
+    std::vector<EdgeId> sorted_edge_ids_;
+    std::vector<Arc> arcs_;
+
+    // Lays out all edges by source, within one source in the order of ids
+    void BuildArcs();
+};
+
+template <typename Weight>
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>>&& edges)
+    : vertex_count_(vertex_count)
+    , edges_(std::move(edges))
+    , incidence_lists_(vertex_count)
+{
+    for (EdgeId id = 0; id < edges_.size(); ++id) {
+        incidence_lists_.at(edges_[id].from).push_back(id);
+    }
+}
+
+template <typename Weight>
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
+    : vertex_count_(vertex_count)
+    , incidence_lists_(vertex_count) {
+}
+
+template <typename Weight>
+EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (IsFrozen()) {
+        throw std::logic_error("Can not add an edge to a frozen graph");
+    }
+    edges_.push_back(edge);
+    const EdgeId id = edges_.size() - 1;
+    incidence_lists_.at(edge.from).push_back(id);
+    return id;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Freeze() {
+    if (IsFrozen()) {
+        return;
+    }
+    BuildArcs();
+    std::vector<IncidenceList>().swap(incidence_lists_);
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Extend(size_t vertex_count, const std::vector<Edge<Weight>>& edges) {
+    if (!IsFrozen()) {
+        throw std::logic_error("Graph is not frozen");
+    }
+    if (vertex_count < vertex_count_) {
+        throw std::invalid_argument("Vertices can not be removed");
+    }
+    vertex_count_ = vertex_count;
+    for (const auto& edge : edges) {
+        if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+    }
+    edges_.insert(edges_.end(), edges.begin(), edges.end());
+    BuildArcs();
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::BuildArcs() {
+    if (vertex_count_ > UINT32_MAX || edges_.size() > UINT32_MAX) {
+        throw std::length_error("Graph is too large to freeze");
+    }
+
+    offsets_.assign(vertex_count_ + 1, 0);
+    for (const auto& edge : edges_) {
+        ++offsets_[edge.from + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        offsets_[vertex + 1] += offsets_[vertex];
+    }
+    sorted_edge_ids_.resize(edges_.size());
+    arcs_.resize(edges_.size());
+    std::vector<size_t> next(offsets_.begin(), offsets_.end() - 1);
+    for (EdgeId id = 0; id < edges_.size(); ++id) {
+        const size_t position = next[edges_[id].from]++;
+        sorted_edge_ids_[position] = id;
+        arcs_[position] = {edges_[id].weight, static_cast<uint32_t>(edges_[id].to), static_cast<uint32_t>(id)};
+    }
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+    return !offsets_.empty();
+}
+
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
+    return vertex_count_;
+}
+
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
+    return edges_.size();
+}
+
+template <typename Weight>
+const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
+    return edges_.at(edge_id);
+}
+
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
+DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
+    if (IsFrozen()) {
+        return {sorted_edge_ids_.begin() + offsets_.at(vertex), sorted_edge_ids_.begin() + offsets_.at(vertex + 1)};
+    }
+    return ranges::AsRange(incidence_lists_.at(vertex));
+}
+
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::ArcsRange
+DirectedWeightedGraph<Weight>::GetOutgoingArcs(VertexId vertex) const {
+    if (!IsFrozen()) {
+        throw std::logic_error("Graph is not frozen");
+    }
+    return {arcs_.begin() + offsets_[vertex], arcs_.begin() + offsets_[vertex + 1]};
+}
+
+template<typename Weight>
+const std::vector<Edge<Weight>>& DirectedWeightedGraph<Weight>::GetEdges() const{
+    return edges_;
+}
+}  // namespace graph
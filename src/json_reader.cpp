@@ -1,333 +1,753 @@
-#include "json_reader.h"
-
-using namespace std;
-geo::Coordinates GetCoords(const json::Node& request) {
-    return { request.AsDict().at("latitude").AsDouble(),request.AsDict().at("longitude").AsDouble() };
-}
-
-std::vector<std::string_view> GetStops(const json::Node& request) {
-    std::vector<std::string_view> result;
-
-    for (auto& element : request.AsDict().at("stops").AsArray()) {
-        result.push_back(element.AsString());
-    }
-    if (!request.AsDict().at("is_roundtrip").AsBool()) {
-        result.insert(result.end(), result.rbegin() + 1, result.rend());
-    }
-
-    return result;
-}
-
-svg::Color SetColor(const json::Node& color_node) {
-    if (color_node.IsString()) {
-        return color_node.AsString();
-    }
-    else {
-        if (color_node.AsArray().size() == 3) {
-            svg::Rgb result(color_node.AsArray()[0].AsInt(), color_node.AsArray()[1].AsInt(), color_node.AsArray()[2].AsInt());
-            return result;
-        }
-        else {
-            svg::Rgba result(color_node.AsArray()[0].AsInt(), color_node.AsArray()[1].AsInt(), color_node.AsArray()[2].AsInt(), color_node.AsArray()[3].AsDouble());
-            return result;
-        }
-    }
-}
-
-std::vector<svg::Color> SetColorVector(const json::Array& arr) {
-    std::vector<svg::Color> result;
-
-    for (auto& color : arr) {
-        result.push_back(SetColor(color));
-    }
-
-    return result;
-}
-
-const std::vector<std::string> GetBusesByStop(catalogue::TransportCatalogue& catalogue, const json::Node& stop_request) {
-    std::vector<std::string> result;
-    catalogue::detail::StopInfo stop_info = catalogue.GetStopInfo(catalogue.FindStop(stop_request.AsDict().at("name").AsString()));
-
-    for (auto& stop : stop_info.buses)
-    {
-        result.push_back(std::string(stop));
-    }
-    return result;
-}
-
-renderer::RendererSettings SetRenderSettings(const json::Dict& settings) {
-    renderer::RendererSettings result;
-
-    auto width_ptr = settings.find("width");
-    if (width_ptr != settings.end()) {
-        result.width_ = width_ptr->second.AsDouble();
-    }
-
-    auto height_ptr = settings.find("height");
-    if (height_ptr != settings.end()) {
-        result.height_ = height_ptr->second.AsDouble();
-    }
-
-    auto padding_ptr = settings.find("padding");
-    if (padding_ptr != settings.end()) {
-        result.padding_ = padding_ptr->second.AsDouble();
-    }
-
-    auto stop_radius_ptr = settings.find("stop_radius");
-    if (stop_radius_ptr != settings.end()) {
-        result.stop_radius_ = stop_radius_ptr->second.AsDouble();
-    }
-
-    auto line_width_ptr = settings.find("line_width");
-    if (line_width_ptr != settings.end()) {
-        result.line_width_ = line_width_ptr->second.AsDouble();
-    }
-
-    auto bus_label_font_size_ptr = settings.find("bus_label_font_size");
-    if (bus_label_font_size_ptr != settings.end()) {
-        result.bus_label_font_size_ = bus_label_font_size_ptr->second.AsInt();
-    }
-
-    auto bus_label_offset_ptr = settings.find("bus_label_offset");
-    if (bus_label_offset_ptr != settings.end()) {
-        result.bus_label_offset_ = { bus_label_offset_ptr->second.AsArray()[0].AsDouble(), bus_label_offset_ptr->second.AsArray()[1].AsDouble() };
-    }
-
-    auto stop_label_font_size_ptr = settings.find("stop_label_font_size");
-    if (stop_label_font_size_ptr != settings.end()) {
-        result.stop_label_font_size_ = stop_label_font_size_ptr->second.AsInt();
-    }
-
-    auto stop_label_offset_ptr = settings.find("stop_label_offset");
-    if (stop_label_offset_ptr != settings.end()) {
-        result.stop_label_offset_ = { stop_label_offset_ptr->second.AsArray()[0].AsDouble(), stop_label_offset_ptr->second.AsArray()[1].AsDouble() };
-    }
-
-    auto underlayer_width_ptr = settings.find("underlayer_width");
-    if (underlayer_width_ptr != settings.end()) {
-        result.underlayer_width_ = underlayer_width_ptr->second.AsDouble();
-    }
-
-    auto underlayer_color_ptr = settings.find("underlayer_color");
-    if (underlayer_color_ptr != settings.end()) {
-        result.underlayer_color_ = SetColor(underlayer_color_ptr->second);
-    }
-
-    auto color_palette_ptr = settings.find("color_palette");
-    if (color_palette_ptr != settings.end()) {
-        result.color_palette_ = SetColorVector(color_palette_ptr->second.AsArray());
-    }
-
-    return result;
-}
-
-router::RouterSettings SetRouterSettings(const json::Dict& settings) {
-    router::RouterSettings result;
-
-    auto bus_wait_time_ptr = settings.find("bus_wait_time");
-    if (bus_wait_time_ptr != settings.end()) {
-        result.bus_wait_time = bus_wait_time_ptr->second.AsInt();
-    }
-
-    auto bus_velocity_ptr = settings.find("bus_velocity");
-    if (bus_velocity_ptr != settings.end()) {
-        result.bus_velocity = bus_velocity_ptr->second.AsDouble() / 3.6;
-    }
-
-    return result;
-}
-void StopRequestsProcessing(catalogue::TransportCatalogue& catalogue, const json::Array& stop_requests) {
-    for (auto& stop_request : stop_requests) {
-        catalogue.AddStop(stop_request.AsDict().at("name").AsString(), GetCoords(stop_request));
-    }
-    for (auto& stop_request : stop_requests) {
-        if (stop_request.AsDict().count("road_distances")) {
-            for (auto& [stop_name, distance] : stop_request.AsDict().at("road_distances").AsDict()) {
-                catalogue.SetStopDistance(catalogue.FindStop(stop_request.AsDict().at("name").AsString()), catalogue.FindStop(stop_name), distance.AsInt());
-            }
-        }
-    }
-}
-
-void BusRequestsProcessing(catalogue::TransportCatalogue& catalogue, const json::Array& bus_requests) {
-    for (auto& bus_request : bus_requests) {
-        catalogue.AddBusRoute(bus_request.AsDict().at("name").AsString(), GetStops(bus_request), bus_request.AsDict().at("is_roundtrip").AsBool());
-    }
-}
-
-void BaseRequestsProcessing(catalogue::TransportCatalogue& catalogue, const json::Array& base_requests) {
-    json::Array bus_requests;
-    json::Array stop_requests;
-
-    for (auto& request : base_requests) {
-        if (request.AsDict().at("type").AsString() == "Bus") {
-            bus_requests.push_back(request);
-        }
-        if (request.AsDict().at("type").AsString() == "Stop") {
-            stop_requests.push_back(request);
-        }
-    }
-
-    StopRequestsProcessing(catalogue, stop_requests);
-    BusRequestsProcessing(catalogue, bus_requests);
-}
-
-json::Dict MapResponseProcessing(catalogue::TransportCatalogue& catalogue, renderer::MapRenderer& renderer, const json::Node& map_request) {
-    std::ostringstream s;
-
-    s << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>";
-    s << '\n';
-    s << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">" << std::endl;
-
-    svg::RenderContext content(s);
-    renderer.RenderMap(content, catalogue.GetRoutes());
-
-    s << "</svg> ";
-
-    return json::Builder().StartDict().Key("request_id"s).Value(map_request.AsDict().at("id")).Key("map"s).Value(s.str()).EndDict().Build().AsDict();
-}
-
-json::Dict BusResponseProcessing(catalogue::TransportCatalogue& catalogue, const json::Node& bus_request) {
-    auto bus_ptr = catalogue.FindBusRoute(bus_request.AsDict().at("name").AsString());
-
-    if (bus_ptr != nullptr) {
-        catalogue::detail::RouteInfo route_info = catalogue.GetRouteInfo(bus_ptr);
-        return json::Builder().
-            StartDict()
-            .Key("request_id"s).Value(bus_request.AsDict().at("id"))
-            .Key("curvature"s).Value(route_info.stats.curvature)
-            .Key("route_length"s).Value(route_info.stats.route_length)
-            .Key("stop_count"s).Value(static_cast<int>(route_info.bus->route.size()))
-            .Key("unique_stop_count"s).Value(static_cast<int>(route_info.bus->unique_stops.size()))
-            .EndDict().Build().AsDict();
-    }
-    else {
-        return json::Builder().StartDict()
-            .Key("request_id"s).Value(bus_request.AsDict().at("id"))
-            .Key("error_message"s).Value("not found"s)
-            .EndDict().Build().AsDict();
-    }
-}
-json::Dict StopResponseProcessing(catalogue::TransportCatalogue& catalogue, const json::Node& stop_request) {
-    auto stop_ptr = catalogue.FindStop(stop_request.AsDict().at("name").AsString());
-
-    if (stop_ptr != nullptr) {
-        auto buses = GetBusesByStop(catalogue, stop_request);
-        return json::Builder().StartDict()
-            .Key("request_id"s).Value(stop_request.AsDict().at("id"))
-            .Key("buses"s).Value(json::Array{ buses.begin(),buses.end() })
-            .EndDict().Build().AsDict();
-    }
-    else {
-        return json::Builder().StartDict()
-            .Key("request_id"s).Value(stop_request.AsDict().at("id"))
-            .Key("error_message"s).Value("not found"s)
-            .EndDict().Build().AsDict();
-    }
-
-}
-
-json::Node ParseRoute(std::optional<graph::Router<double>::RouteInfo> route, const router::TransportRouter& router) {
-    json::Builder result;
-
-    if (route.has_value()) {
-        result.StartArray();
-        for (auto& edgeid : route->edges) {
-            auto& element = router.GetEdge(edgeid);
-
-            if (element.bus_name == "") {
-                result.StartDict()
-                    .Key("stop_name"s).Value(router.GetIdsToStops().at(element.to)->Stop_name)
-                    .Key("time"s).Value(element.weight)
-                    .Key("type"s).Value("Wait"s)
-                    .EndDict();
-            }
-            else {
-                result.StartDict()
-                    .Key("bus"s).Value(std::string(element.bus_name))
-                    .Key("span_count"s).Value(element.span_count)
-                    .Key("time"s).Value(element.weight)
-                    .Key("type"s).Value("Bus"s)
-                    .EndDict();
-            }
-        }
-        return result.EndArray().Build();
-    }
-
-    return 	{};
-}
-
-json::Dict RouteResponseProcessing(router::TransportRouter& router, const json::Node& route_request) {
-    json::Builder result;
-    json::Node route = ParseRoute(router.BuildRoute(route_request.AsDict().at("from"s).AsString(), route_request.AsDict().at("to"s).AsString()),router);
-
-    if (route.IsNull()) {
-        result.StartDict().Key("error_message").Value("not found"s);
-        result.Key("request_id"s).Value(route_request.AsDict().at("id").AsInt());
-        return result.EndDict().Build().AsDict();
-    }
-
-    double total_time = 0;
-    for (auto& element : route.AsArray()) {
-        total_time += element.AsDict().at("time").AsDouble();
-    }
-
-    return result.StartDict().Key("items").Value(route).Key("request_id"s).Value(route_request.AsDict().at("id").AsInt()).Key("total_time").Value(total_time).EndDict().Build().AsDict();
-}
-
-json::Node StatRequestsProcessing(catalogue::TransportCatalogue& catalogue, renderer::MapRenderer& renderer, router::TransportRouter& router, const json::Array& stat_requests) {
-    json::Builder responses;
-    responses.StartArray();
-    for (auto& request : stat_requests) {
-        if (request.AsDict().at("type").AsString() == "Bus") {
-            responses.Value(BusResponseProcessing(catalogue, request));
-        }
-        if (request.AsDict().at("type").AsString() == "Stop") {
-            responses.Value(StopResponseProcessing(catalogue, request));
-        }
-        if (request.AsDict().at("type").AsString() == "Map") {
-            responses.Value(MapResponseProcessing(catalogue, renderer, request));
-        }
-        if (request.AsDict().at("type").AsString() == "Route") {
-            responses.Value(RouteResponseProcessing(router, request));
-        }
-    }
-    return responses.EndArray().Build();
-}
-
-void PrintResponses(const json::Node& responses) {
-    json::Print(responses, std::cout);
-}
-
-void InitializeAndSerializeDataBase() {
-    catalogue::TransportCatalogue catalogue; 
-    renderer::MapRenderer renderer;
-    json::Node requests = json::Load(std::cin);
-
-    BaseRequestsProcessing(catalogue, requests.AsDict().at("base_requests").AsArray());
-
-    renderer.InsertSettings(SetRenderSettings(requests.AsDict().at("render_settings").AsDict()));
-
-    router::TransportRouter transport_router(SetRouterSettings(requests.AsDict().at("routing_settings").AsDict()), &catalogue);
-    transport_router.BuildRouter();
-
-    SerializeDataBase(catalogue, renderer, transport_router, requests.AsDict().at("serialization_settings").AsDict().at("file").AsString());
-}
-
-void RequestsProcessing() {
-
-    json::Node requests = json::Load(std::cin);
-
-    transport_catalogue_serialize::DataBase database;
-
-    std::ifstream in;
-    in.open(requests.AsDict().at("serialization_settings").AsDict().at("file").AsString(), std::ios::binary);
-    database.ParseFromIstream(&in);
-    catalogue::TransportCatalogue catalogue(*database.mutable_catalogue_base());
-
-    renderer::MapRenderer renderer;
-    renderer.InsertSettings(*database.mutable_render_settings());
-    router::TransportRouter transport_router(database.transport_router_base(), catalogue);
-
-    PrintResponses(json::Builder().Value(StatRequestsProcessing(catalogue, renderer, transport_router, requests.AsDict().at("stat_requests").AsArray())).Build());
-}
+#include "json_reader.h"
+
+using namespace std;
+geo::Coordinates GetCoords(const json::Node& request) {
+    return { request.AsDict().at("latitude").AsDouble(),request.AsDict().at("longitude").AsDouble() };
+}
+
+std::vector<std::string_view> GetStops(const json::Node& request) {
+    std::vector<std::string_view> result;
+
+    for (auto& element : request.AsDict().at("stops").AsArray()) {
+        result.push_back(element.AsString());
+    }
+    if (!request.AsDict().at("is_roundtrip").AsBool()) {
+        result.insert(result.end(), result.rbegin() + 1, result.rend());
+    }
+
+    return result;
+}
+
+svg::Color SetColor(const json::Node& color_node) {
+    if (color_node.IsString()) {
+        return color_node.AsString();
+    }
+    else {
+        if (color_node.AsArray().size() == 3) {
+            svg::Rgb result(color_node.AsArray()[0].AsInt(), color_node.AsArray()[1].AsInt(), color_node.AsArray()[2].AsInt());
+            return result;
+        }
+        else {
+            svg::Rgba result(color_node.AsArray()[0].AsInt(), color_node.AsArray()[1].AsInt(), color_node.AsArray()[2].AsInt(), color_node.AsArray()[3].AsDouble());
+            return result;
+        }
+    }
+}
+
+std::vector<svg::Color> SetColorVector(const json::Array& arr) {
+    std::vector<svg::Color> result;
+
+    for (auto& color : arr) {
+        result.push_back(SetColor(color));
+    }
+
+    return result;
+}
+
+renderer::RendererSettings SetRenderSettings(const json::Dict& settings) {
+    renderer::RendererSettings result;
+
+    auto width_ptr = settings.find("width");
+    if (width_ptr != settings.end()) {
+        result.width_ = width_ptr->second.AsDouble();
+    }
+
+    auto height_ptr = settings.find("height");
+    if (height_ptr != settings.end()) {
+        result.height_ = height_ptr->second.AsDouble();
+    }
+
+    auto padding_ptr = settings.find("padding");
+    if (padding_ptr != settings.end()) {
+        result.padding_ = padding_ptr->second.AsDouble();
+    }
+
+    auto stop_radius_ptr = settings.find("stop_radius");
+    if (stop_radius_ptr != settings.end()) {
+        result.stop_radius_ = stop_radius_ptr->second.AsDouble();
+    }
+
+    auto line_width_ptr = settings.find("line_width");
+    if (line_width_ptr != settings.end()) {
+        result.line_width_ = line_width_ptr->second.AsDouble();
+    }
+
+    auto bus_label_font_size_ptr = settings.find("bus_label_font_size");
+    if (bus_label_font_size_ptr != settings.end()) {
+        result.bus_label_font_size_ = bus_label_font_size_ptr->second.AsInt();
+    }
+
+    auto bus_label_offset_ptr = settings.find("bus_label_offset");
+    if (bus_label_offset_ptr != settings.end()) {
+        result.bus_label_offset_ = { bus_label_offset_ptr->second.AsArray()[0].AsDouble(), bus_label_offset_ptr->second.AsArray()[1].AsDouble() };
+    }
+
+    auto stop_label_font_size_ptr = settings.find("stop_label_font_size");
+    if (stop_label_font_size_ptr != settings.end()) {
+        result.stop_label_font_size_ = stop_label_font_size_ptr->second.AsInt();
+    }
+
+    auto stop_label_offset_ptr = settings.find("stop_label_offset");
+    if (stop_label_offset_ptr != settings.end()) {
+        result.stop_label_offset_ = { stop_label_offset_ptr->second.AsArray()[0].AsDouble(), stop_label_offset_ptr->second.AsArray()[1].AsDouble() };
+    }
+
+    auto underlayer_width_ptr = settings.find("underlayer_width");
+    if (underlayer_width_ptr != settings.end()) {
+        result.underlayer_width_ = underlayer_width_ptr->second.AsDouble();
+    }
+
+    auto underlayer_color_ptr = settings.find("underlayer_color");
+    if (underlayer_color_ptr != settings.end()) {
+        result.underlayer_color_ = SetColor(underlayer_color_ptr->second);
+    }
+
+    auto color_palette_ptr = settings.find("color_palette");
+    if (color_palette_ptr != settings.end()) {
+        result.color_palette_ = SetColorVector(color_palette_ptr->second.AsArray());
+    }
+
+    return result;
+}
+
+router::RouterSettings SetRouterSettings(const json::Dict& settings) {
+    router::RouterSettings result;
+
+    auto bus_wait_time_ptr = settings.find("bus_wait_time");
+    if (bus_wait_time_ptr != settings.end()) {
+        result.bus_wait_time = bus_wait_time_ptr->second.AsInt();
+    }
+
+    auto bus_velocity_ptr = settings.find("bus_velocity");
+    if (bus_velocity_ptr != settings.end()) {
+        result.bus_velocity = bus_velocity_ptr->second.AsDouble() / 3.6;
+    }
+
+    auto router_engine_ptr = settings.find("router_engine");
+    if (router_engine_ptr != settings.end()) {
+        if (router_engine_ptr->second.AsString() == "dijkstra") {
+            result.engine = router::RouterEngine::DIJKSTRA;
+        }
+        else if (router_engine_ptr->second.AsString() == "contraction_hierarchies") {
+            result.engine = router::RouterEngine::CONTRACTION_HIERARCHIES;
+        }
+        else if (router_engine_ptr->second.AsString() == "a_star") {
+            result.engine = router::RouterEngine::A_STAR;
+        }
+        else if (router_engine_ptr->second.AsString() == "raptor") {
+            result.engine = router::RouterEngine::RAPTOR;
+        }
+        else if (router_engine_ptr->second.AsString() == "floyd_warshall") {
+            result.engine = router::RouterEngine::FLOYD_WARSHALL;
+        }
+        else {
+            throw std::invalid_argument("unknown router_engine");
+        }
+    }
+
+    auto graph_model_ptr = settings.find("graph_model");
+    if (graph_model_ptr != settings.end()) {
+        if (graph_model_ptr->second.AsString() == "route_pattern") {
+            result.graph_model = router::GraphModel::ROUTE_PATTERN;
+        }
+        else if (graph_model_ptr->second.AsString() == "span_edges") {
+            result.graph_model = router::GraphModel::SPAN_EDGES;
+        }
+        else {
+            throw std::invalid_argument("unknown graph_model");
+        }
+    }
+
+    auto walk_velocity_ptr = settings.find("walk_velocity");
+    if (walk_velocity_ptr != settings.end()) {
+        result.walk_velocity = walk_velocity_ptr->second.AsDouble() / 3.6;
+    }
+
+    auto footpath_radius_ptr = settings.find("footpath_radius");
+    if (footpath_radius_ptr != settings.end()) {
+        result.footpath_radius = footpath_radius_ptr->second.AsDouble();
+        if (result.footpath_radius > 0 && !(result.walk_velocity > 0)) {
+            throw std::invalid_argument("footpath_radius needs walk_velocity");
+        }
+        if (result.footpath_radius > 0 && result.engine == router::RouterEngine::RAPTOR) {
+            throw std::invalid_argument("footpaths need a graph engine");
+        }
+    }
+
+    auto integer_weights_ptr = settings.find("integer_weights");
+    if (integer_weights_ptr != settings.end()) {
+        result.integer_weights = integer_weights_ptr->second.AsBool();
+        if (result.integer_weights && result.engine != router::RouterEngine::FLOYD_WARSHALL && result.engine != router::RouterEngine::DIJKSTRA) {
+            throw std::invalid_argument("integer_weights need floyd_warshall or dijkstra");
+        }
+    }
+
+    return result;
+}
+void StopRequestsProcessing(catalogue::TransportCatalogue& catalogue, const json::Array& stop_requests) {
+    for (auto& stop_request : stop_requests) {
+        catalogue.AddStop(stop_request.AsDict().at("name").AsString(), GetCoords(stop_request));
+    }
+    for (auto& stop_request : stop_requests) {
+        if (stop_request.AsDict().count("road_distances")) {
+            for (auto& [stop_name, distance] : stop_request.AsDict().at("road_distances").AsDict()) {
+                catalogue.SetStopDistance(catalogue.FindStop(stop_request.AsDict().at("name").AsString()), catalogue.FindStop(stop_name), distance.AsInt());
+            }
+        }
+    }
+    catalogue.BuildStopIndex();
+}
+
+void BusRequestsProcessing(catalogue::TransportCatalogue& catalogue, const json::Array& bus_requests) {
+    for (auto& bus_request : bus_requests) {
+        catalogue.AddBusRoute(bus_request.AsDict().at("name").AsString(), GetStops(bus_request), bus_request.AsDict().at("is_roundtrip").AsBool());
+    }
+}
+
+void BaseRequestsProcessing(catalogue::TransportCatalogue& catalogue, const json::Array& base_requests) {
+    json::Array bus_requests;
+    json::Array stop_requests;
+
+    for (auto& request : base_requests) {
+        if (request.AsDict().at("type").AsString() == "Bus") {
+            bus_requests.push_back(request);
+        }
+        if (request.AsDict().at("type").AsString() == "Stop") {
+            stop_requests.push_back(request);
+        }
+    }
+
+    StopRequestsProcessing(catalogue, stop_requests);
+    BusRequestsProcessing(catalogue, bus_requests);
+}
+
+json::Dict MapResponseProcessing(catalogue::TransportCatalogue& catalogue, renderer::MapRenderer& renderer, const json::Node& map_request) {
+    std::ostringstream s;
+
+    s << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>";
+    s << '\n';
+    s << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">" << std::endl;
+
+    svg::RenderContext content(s);
+    renderer.RenderMap(content, catalogue.GetRoutes(), catalogue.GetStopCoordinates());
+
+    s << "</svg> ";
+
+    return json::Builder().StartDict().Key("request_id"s).Value(map_request.AsDict().at("id")).Key("map"s).Value(s.str()).EndDict().Build().AsDict();
+}
+
+json::Dict BusResponseProcessing(catalogue::TransportCatalogue& catalogue, const json::Node& bus_request) {
+    auto bus_ptr = catalogue.FindBusRoute(bus_request.AsDict().at("name").AsString());
+
+    if (bus_ptr != nullptr) {
+        catalogue::detail::RouteInfo route_info = catalogue.GetRouteInfo(bus_ptr);
+        return json::Builder().
+            StartDict()
+            .Key("request_id"s).Value(bus_request.AsDict().at("id"))
+            .Key("curvature"s).Value(route_info.stats.curvature)
+            .Key("route_length"s).Value(route_info.stats.route_length)
+            .Key("stop_count"s).Value(route_info.stats.stop_count)
+            .Key("unique_stop_count"s).Value(route_info.stats.unique_stop_count)
+            .EndDict().Build().AsDict();
+    }
+    else {
+        return json::Builder().StartDict()
+            .Key("request_id"s).Value(bus_request.AsDict().at("id"))
+            .Key("error_message"s).Value("not found"s)
+            .EndDict().Build().AsDict();
+    }
+}
+json::Dict StopResponseProcessing(catalogue::TransportCatalogue& catalogue, const json::Node& stop_request) {
+    auto stop_ptr = catalogue.FindStop(stop_request.AsDict().at("name").AsString());
+
+    if (stop_ptr != nullptr) {
+        const auto& stop_buses = catalogue.GetStopBuses(stop_ptr);
+        json::Array buses;
+        buses.reserve(stop_buses.size());
+        for (auto bus : stop_buses) {
+            buses.emplace_back(std::string(bus->bus_name));
+        }
+        return json::Builder().StartDict()
+            .Key("request_id"s).Value(stop_request.AsDict().at("id"))
+            .Key("buses"s).Value(std::move(buses))
+            .EndDict().Build().AsDict();
+    }
+    else {
+        return json::Builder().StartDict()
+            .Key("request_id"s).Value(stop_request.AsDict().at("id"))
+            .Key("error_message"s).Value("not found"s)
+            .EndDict().Build().AsDict();
+    }
+
+}
+
+json::Dict WalkItem(const router::WalkLeg& walk, const domain::Stop* from, const domain::Stop* to) {
+    json::Dict result{ {"distance"s, walk.distance}, {"time"s, walk.time}, {"type"s, "Walk"s} };
+    if (from) {
+        result.emplace("from"s, std::string(from->Stop_name));
+    }
+    if (to) {
+        result.emplace("to"s, std::string(to->Stop_name));
+    }
+    return result;
+}
+
+json::Node ParseRoute(std::optional<graph::Router<double>::RouteInfo> route, const router::TransportRouter& router) {
+    json::Builder result;
+
+    if (route.has_value()) {
+        result.StartArray();
+
+        // Consecutive rides of one bus are reported as a single Bus item,
+        // boarding and alighting edges (zero span count) only separate them
+        domain::NameId ride_bus = domain::NO_NAME;
+        int ride_span_count = 0;
+        double ride_time = 0;
+        const auto flush_ride = [&]() {
+            if (ride_span_count == 0) {
+                return;
+            }
+            result.StartDict()
+                .Key("bus"s).Value(std::string(router.GetName(ride_bus)))
+                .Key("span_count"s).Value(ride_span_count)
+                .Key("time"s).Value(ride_time)
+                .Key("type"s).Value("Bus"s)
+                .EndDict();
+            ride_span_count = 0;
+            ride_time = 0;
+        };
+
+        for (auto& edgeid : route->edges) {
+            auto& element = router.GetEdge(edgeid);
+
+            if (router.IsFootpath(element)) {
+                flush_ride();
+                const domain::Stop* from = router.GetVertexStop(element.from);
+                const domain::Stop* to = router.GetVertexStop(element.to);
+                result.Value(WalkItem({ router.GetFootpathDistance(element),element.weight }, from, to));
+            }
+            else if (element.bus_name_id == domain::NO_NAME) {
+                flush_ride();
+                result.StartDict()
+                    .Key("stop_name"s).Value(std::string(router.GetVertexStop(element.to)->Stop_name))
+                    .Key("time"s).Value(element.weight)
+                    .Key("type"s).Value("Wait"s)
+                    .EndDict();
+            }
+            else if (element.span_count == 0) {
+                flush_ride();
+            }
+            else {
+                ride_bus = element.bus_name_id;
+                ride_span_count += element.span_count;
+                ride_time += element.weight;
+            }
+        }
+        flush_ride();
+        return result.EndArray().Build();
+    }
+
+    return 	{};
+}
+
+router::Disruptions ParseDisruptions(const json::Node& disruptions) {
+    router::Disruptions result;
+    auto stops_ptr = disruptions.AsDict().find("stops"s);
+    if (stops_ptr != disruptions.AsDict().end()) {
+        for (auto& stop : stops_ptr->second.AsArray()) {
+            result.stops.push_back(stop.AsString());
+        }
+    }
+    auto buses_ptr = disruptions.AsDict().find("buses"s);
+    if (buses_ptr != disruptions.AsDict().end()) {
+        for (auto& bus : buses_ptr->second.AsArray()) {
+            result.buses.push_back(bus.AsString());
+        }
+    }
+    return result;
+}
+
+json::Node ParseJourney(const router::Journey& journey, const router::TransportRouter& router) {
+    json::Builder result;
+    result.StartArray();
+    for (auto& leg : journey.legs) {
+        result.StartDict()
+            .Key("stop_name"s).Value(std::string(leg.from->Stop_name))
+            .Key("time"s).Value(router.GetRouterSettings().bus_wait_time)
+            .Key("type"s).Value("Wait"s)
+            .EndDict();
+        result.StartDict()
+            .Key("bus"s).Value(std::string(leg.bus->bus_name))
+            .Key("span_count"s).Value(leg.span_count)
+            .Key("time"s).Value(leg.time)
+            .Key("type"s).Value("Bus"s)
+            .EndDict();
+    }
+    return result.EndArray().Build();
+}
+
+// The fastest journey is reported as a usual route, "journeys" adds the fastest one
+// for every number of transfers that saves time over fewer transfers
+json::Dict JourneysResponseProcessing(router::TransportRouter& router, const json::Node& route_request) {
+    json::Builder result;
+    auto journeys = router.BuildJourneys(route_request.AsDict().at("from"s).AsString(), route_request.AsDict().at("to"s).AsString());
+
+    if (journeys.empty()) {
+        result.StartDict().Key("error_message").Value("not found"s);
+        result.Key("request_id"s).Value(route_request.AsDict().at("id").AsInt());
+        return result.EndDict().Build().AsDict();
+    }
+
+    result.StartDict()
+        .Key("items").Value(ParseJourney(journeys.back(), router))
+        .Key("request_id"s).Value(route_request.AsDict().at("id").AsInt())
+        .Key("total_time").Value(journeys.back().total_time)
+        .Key("journeys").StartArray();
+    for (auto& journey : journeys) {
+        result.StartDict()
+            .Key("items").Value(ParseJourney(journey, router))
+            .Key("total_time").Value(journey.total_time)
+            .Key("transfer_count").Value(static_cast<int>(journey.GetTransferCount()))
+            .EndDict();
+    }
+    return result.EndArray().EndDict().Build().AsDict();
+}
+
+double ComputeTotalTime(const json::Node& route) {
+    double total_time = 0;
+    for (auto& element : route.AsArray()) {
+        total_time += element.AsDict().at("time").AsDouble();
+    }
+    return total_time;
+}
+
+// The best route is reported as usual, "alternatives" lists all found routes including it
+json::Dict AlternativesResponseProcessing(router::TransportRouter& router, const json::Node& route_request) {
+    json::Builder result;
+    std::optional<router::Disruptions> disruptions;
+    if (route_request.AsDict().count("disruptions"s)) {
+        disruptions = ParseDisruptions(route_request.AsDict().at("disruptions"s));
+    }
+    auto routes = router.BuildRoutes(route_request.AsDict().at("from"s).AsString(), route_request.AsDict().at("to"s).AsString(),
+        static_cast<size_t>(std::max(0, route_request.AsDict().at("alternatives"s).AsInt())), disruptions ? &*disruptions : nullptr);
+
+    if (routes.empty()) {
+        result.StartDict().Key("error_message").Value("not found"s);
+        result.Key("request_id"s).Value(route_request.AsDict().at("id").AsInt());
+        return result.EndDict().Build().AsDict();
+    }
+
+    json::Array alternatives;
+    for (auto& route : routes) {
+        json::Node items = ParseRoute(std::move(route), router);
+        const double total_time = ComputeTotalTime(items);
+        alternatives.push_back(json::Builder{}.StartDict().Key("items").Value(std::move(items)).Key("total_time").Value(total_time).EndDict().Build());
+    }
+    const json::Dict& best = alternatives.front().AsDict();
+
+    return result.StartDict()
+        .Key("items").Value(best.at("items"))
+        .Key("request_id"s).Value(route_request.AsDict().at("id").AsInt())
+        .Key("total_time").Value(best.at("total_time"))
+        .Key("alternatives").Value(alternatives)
+        .EndDict().Build().AsDict();
+}
+
+// Route between points given by their coordinates: Walk items come before and after the route's
+// Wait and Bus items, or a single Walk item says that walking all the way is fastest
+json::Dict PointRouteResponseProcessing(router::TransportRouter& router, const json::Node& route_request) {
+    std::optional<router::Disruptions> disruptions;
+    if (route_request.AsDict().count("disruptions"s)) {
+        disruptions = ParseDisruptions(route_request.AsDict().at("disruptions"s));
+    }
+    // The request's walk_velocity overrides the one of routing_settings
+    double walk_velocity = router.GetRouterSettings().walk_velocity;
+    if (route_request.AsDict().count("walk_velocity"s)) {
+        walk_velocity = route_request.AsDict().at("walk_velocity"s).AsDouble() / 3.6;
+    }
+    if (!(walk_velocity > 0)) {
+        json::Builder result;
+        result.StartDict().Key("error_message").Value("walk_velocity is not set"s);
+        result.Key("request_id"s).Value(route_request.AsDict().at("id").AsInt());
+        return result.EndDict().Build().AsDict();
+    }
+    const auto route = router.BuildRoute(GetCoords(route_request.AsDict().at("from"s)), GetCoords(route_request.AsDict().at("to"s)),
+        walk_velocity, disruptions ? &*disruptions : nullptr);
+
+    json::Array items;
+    if (!route.from_stop) {
+        items.push_back(WalkItem(route.first_walk, nullptr, nullptr));
+    }
+    else {
+        items.push_back(WalkItem(route.first_walk, nullptr, route.from_stop));
+        const json::Node route_items = ParseRoute(route.route, router);
+        items.insert(items.end(), route_items.AsArray().begin(), route_items.AsArray().end());
+        items.push_back(WalkItem(route.last_walk, route.to_stop, nullptr));
+    }
+
+    return json::Builder().StartDict()
+        .Key("items"s).Value(std::move(items))
+        .Key("request_id"s).Value(route_request.AsDict().at("id").AsInt())
+        .Key("total_time"s).Value(route.total_time)
+        .EndDict().Build().AsDict();
+}
+
+json::Dict RouteResponseProcessing(router::TransportRouter& router, const json::Node& route_request) {
+    if (route_request.AsDict().at("from"s).IsDict()) {
+        if (router.GetRouterSettings().engine == router::RouterEngine::RAPTOR) {
+            json::Builder result;
+            result.StartDict().Key("error_message").Value("routes between points need a graph engine"s);
+            result.Key("request_id"s).Value(route_request.AsDict().at("id").AsInt());
+            return result.EndDict().Build().AsDict();
+        }
+        return PointRouteResponseProcessing(router, route_request);
+    }
+    if (router.GetRouterSettings().engine == router::RouterEngine::RAPTOR) {
+        if (route_request.AsDict().count("disruptions"s)) {
+            json::Builder result;
+            result.StartDict().Key("error_message").Value("disruptions need a graph engine"s);
+            result.Key("request_id"s).Value(route_request.AsDict().at("id").AsInt());
+            return result.EndDict().Build().AsDict();
+        }
+        return JourneysResponseProcessing(router, route_request);
+    }
+    if (route_request.AsDict().count("alternatives"s)) {
+        return AlternativesResponseProcessing(router, route_request);
+    }
+    auto search_stats_ptr = route_request.AsDict().find("search_stats"s);
+    const bool with_stats = search_stats_ptr != route_request.AsDict().end() && search_stats_ptr->second.AsBool();
+    graph::SearchStats stats;
+
+    std::optional<router::Disruptions> disruptions;
+    if (route_request.AsDict().count("disruptions"s)) {
+        disruptions = ParseDisruptions(route_request.AsDict().at("disruptions"s));
+    }
+
+    json::Builder result;
+    json::Node route = ParseRoute(router.BuildRoute(route_request.AsDict().at("from"s).AsString(), route_request.AsDict().at("to"s).AsString(),
+        with_stats ? &stats : nullptr, disruptions ? &*disruptions : nullptr), router);
+
+    if (route.IsNull()) {
+        result.StartDict().Key("error_message").Value("not found"s);
+        result.Key("request_id"s).Value(route_request.AsDict().at("id").AsInt());
+        return result.EndDict().Build().AsDict();
+    }
+
+    json::Dict response = result.StartDict().Key("items").Value(route).Key("request_id"s).Value(route_request.AsDict().at("id").AsInt()).Key("total_time").Value(ComputeTotalTime(route)).EndDict().Build().AsDict();
+    if (with_stats) {
+        response["settled_vertices"s] = static_cast<int>(stats.settled_vertices);
+    }
+    return response;
+}
+
+json::Dict MatrixResponseProcessing(router::TransportRouter& router, const json::Node& matrix_request) {
+    std::vector<std::string_view> from;
+    for (auto& stop : matrix_request.AsDict().at("from"s).AsArray()) {
+        from.push_back(stop.AsString());
+    }
+    std::vector<std::string_view> to;
+    for (auto& stop : matrix_request.AsDict().at("to"s).AsArray()) {
+        to.push_back(stop.AsString());
+    }
+
+    json::Builder result;
+    result.StartDict().Key("request_id"s).Value(matrix_request.AsDict().at("id").AsInt()).Key("times"s).StartArray();
+    for (auto& row : router.BuildMatrix(from, to)) {
+        result.StartArray();
+        for (auto& time : row) {
+            result.Value(time ? json::Node(*time) : json::Node(nullptr));
+        }
+        result.EndArray();
+    }
+    return result.EndArray().EndDict().Build().AsDict();
+}
+
+json::Dict IsochroneResponseProcessing(router::TransportRouter& router, const json::Node& isochrone_request) {
+    json::Builder result;
+    result.StartDict().Key("request_id"s).Value(isochrone_request.AsDict().at("id").AsInt()).Key("stops"s).StartArray();
+    for (auto& [stop, time] : router.BuildIsochrone(isochrone_request.AsDict().at("stop_name"s).AsString(), isochrone_request.AsDict().at("max_time"s).AsDouble())) {
+        result.StartDict()
+            .Key("stop_name"s).Value(std::string(stop->Stop_name))
+            .Key("time"s).Value(time)
+            .EndDict();
+    }
+    return result.EndArray().EndDict().Build().AsDict();
+}
+
+json::Dict NearestStopsResponseProcessing(catalogue::TransportCatalogue& catalogue, const json::Node& nearest_request) {
+    const geo::Coordinates point = GetCoords(nearest_request);
+    json::Builder result;
+    result.StartDict().Key("request_id"s).Value(nearest_request.AsDict().at("id").AsInt()).Key("stops"s).StartArray();
+    for (auto& [stop, distance] : catalogue.FindNearestStops(point, static_cast<size_t>(std::max(0, nearest_request.AsDict().at("count"s).AsInt())))) {
+        result.StartDict()
+            .Key("stop_name"s).Value(std::string(stop->Stop_name))
+            .Key("distance"s).Value(distance)
+            .EndDict();
+    }
+    return result.EndArray().EndDict().Build().AsDict();
+}
+
+json::Dict StopsInBoxResponseProcessing(catalogue::TransportCatalogue& catalogue, const json::Node& box_request) {
+    const auto& request = box_request.AsDict();
+    auto stops = catalogue.FindStopsInBox({ request.at("min_latitude"s).AsDouble(), request.at("min_longitude"s).AsDouble() },
+        { request.at("max_latitude"s).AsDouble(), request.at("max_longitude"s).AsDouble() });
+    std::sort(stops.begin(), stops.end(), [](const domain::Stop* lhs, const domain::Stop* rhs) {
+        return lhs->Stop_name < rhs->Stop_name;
+    });
+
+    json::Builder result;
+    result.StartDict().Key("request_id"s).Value(request.at("id").AsInt()).Key("stops"s).StartArray();
+    for (auto stop : stops) {
+        result.Value(std::string(stop->Stop_name));
+    }
+    return result.EndArray().EndDict().Build().AsDict();
+}
+
+json::Node StatRequestsProcessing(catalogue::TransportCatalogue& catalogue, renderer::MapRenderer& renderer, router::TransportRouter& router, const json::Array& stat_requests) {
+    json::Builder responses;
+    responses.StartArray();
+    for (auto& request : stat_requests) {
+        if (request.AsDict().at("type").AsString() == "Bus") {
+            responses.Value(BusResponseProcessing(catalogue, request));
+        }
+        if (request.AsDict().at("type").AsString() == "Stop") {
+            responses.Value(StopResponseProcessing(catalogue, request));
+        }
+        if (request.AsDict().at("type").AsString() == "Map") {
+            responses.Value(MapResponseProcessing(catalogue, renderer, request));
+        }
+        if (request.AsDict().at("type").AsString() == "Route") {
+            responses.Value(RouteResponseProcessing(router, request));
+        }
+        if (request.AsDict().at("type").AsString() == "Matrix") {
+            responses.Value(MatrixResponseProcessing(router, request));
+        }
+        if (request.AsDict().at("type").AsString() == "Isochrone") {
+            responses.Value(IsochroneResponseProcessing(router, request));
+        }
+        if (request.AsDict().at("type").AsString() == "NearestStops") {
+            responses.Value(NearestStopsResponseProcessing(catalogue, request));
+        }
+        if (request.AsDict().at("type").AsString() == "StopsInBox") {
+            responses.Value(StopsInBoxResponseProcessing(catalogue, request));
+        }
+    }
+    return responses.EndArray().Build();
+}
+
+void PrintResponses(const json::Node& responses) {
+    json::Print(responses, std::cout);
+}
+
+// Loads the base from the file, applies the base_delta section to it and writes it back. Stop requests set road
+// distances of stops already in the base, Bus requests add buses, removed_buses are no longer served.
+// Only the changed part of the graph is built again, the table or the hierarchy of the base stays in use.
+void UpdateDataBase(const std::string& file, const json::Dict& delta) {
+    transport_catalogue_serialize::DataBase database;
+    std::ifstream in;
+    in.open(file, std::ios::binary);
+    if (!in || !database.ParseFromIstream(&in)) {
+        throw std::runtime_error("Can not read the base to apply base_delta to");
+    }
+    in.close();
+    catalogue::TransportCatalogue catalogue(*database.mutable_catalogue_base());
+    renderer::MapRenderer renderer;
+    renderer.InsertSettings(*database.mutable_render_settings());
+    router::TransportRouter transport_router(database.transport_router_base(), catalogue);
+
+    router::RouterDelta router_delta;
+    auto requests_ptr = delta.find("base_requests"s);
+    const json::Array requests = requests_ptr != delta.end() ? requests_ptr->second.AsArray() : json::Array{};
+    for (auto& request : requests) {
+        if (request.AsDict().at("type").AsString() != "Stop" || !request.AsDict().count("road_distances")) {
+            continue;
+        }
+        const domain::Stop* stop = catalogue.FindStop(request.AsDict().at("name").AsString());
+        if (stop == nullptr) {
+            throw std::invalid_argument("base_delta can not add stops");
+        }
+        for (auto& [stop_name, distance] : request.AsDict().at("road_distances").AsDict()) {
+            const domain::Stop* other = catalogue.FindStop(stop_name);
+            if (other == nullptr) {
+                throw std::invalid_argument("base_delta can not add stops");
+            }
+            catalogue.SetStopDistance(stop, other, distance.AsInt());
+            router_delta.changed_distances.push_back({ stop->Stop_name,other->Stop_name });
+        }
+    }
+    for (auto& request : requests) {
+        if (request.AsDict().at("type").AsString() != "Bus") {
+            continue;
+        }
+        const std::string& name = request.AsDict().at("name").AsString();
+        if (catalogue.FindBusRoute(name) != nullptr) {
+            throw std::invalid_argument("base_delta can only add new buses");
+        }
+        for (auto stop_name : GetStops(request)) {
+            if (catalogue.FindStop(stop_name) == nullptr) {
+                throw std::invalid_argument("base_delta can not add stops");
+            }
+        }
+        catalogue.AddBusRoute(name, GetStops(request), request.AsDict().at("is_roundtrip").AsBool());
+        router_delta.added_buses.push_back(catalogue.FindBusRoute(name)->bus_name);
+    }
+    auto removed_ptr = delta.find("removed_buses"s);
+    if (removed_ptr != delta.end()) {
+        for (auto& bus : removed_ptr->second.AsArray()) {
+            router_delta.removed_buses.push_back(bus.AsString());
+        }
+    }
+
+    transport_router.ApplyDelta(router_delta);
+    SerializeDataBase(catalogue, renderer, transport_router, file);
+}
+
+void InitializeAndSerializeDataBase() {
+    catalogue::TransportCatalogue catalogue; 
+    renderer::MapRenderer renderer;
+    json::Node requests = json::Load(std::cin);
+
+    const auto& serialization_settings = requests.AsDict().at("serialization_settings").AsDict();
+    auto delta_ptr = requests.AsDict().find("base_delta"s);
+    if (delta_ptr != requests.AsDict().end()) {
+        UpdateDataBase(serialization_settings.at("file").AsString(), delta_ptr->second.AsDict());
+        return;
+    }
+    auto compact_ptr = serialization_settings.find("compact_coordinates");
+    if (compact_ptr != serialization_settings.end()) {
+        catalogue.SetCompactCoordinates(compact_ptr->second.AsBool());
+    }
+    BaseRequestsProcessing(catalogue, requests.AsDict().at("base_requests").AsArray());
+
+    renderer.InsertSettings(SetRenderSettings(requests.AsDict().at("render_settings").AsDict()));
+
+    router::TransportRouter transport_router(SetRouterSettings(requests.AsDict().at("routing_settings").AsDict()), &catalogue);
+    transport_router.BuildRouter();
+    if (transport_router.GetRouterSettings().footpath_radius > 0) {
+        std::cerr << "footpath edges: " << transport_router.GetFootpathCount() << std::endl;
+    }
+
+    SerializeDataBase(catalogue, renderer, transport_router, serialization_settings.at("file").AsString());
+}
+
+void RequestsProcessing() {
+
+    json::Node requests = json::Load(std::cin);
+
+    transport_catalogue_serialize::DataBase database;
+
+    std::ifstream in;
+    in.open(requests.AsDict().at("serialization_settings").AsDict().at("file").AsString(), std::ios::binary);
+    database.ParseFromIstream(&in);
+    catalogue::TransportCatalogue catalogue(*database.mutable_catalogue_base());
+
+    renderer::MapRenderer renderer;
+    renderer.InsertSettings(*database.mutable_render_settings());
+    router::TransportRouter transport_router(database.transport_router_base(), catalogue);
+    auto disruptions_ptr = requests.AsDict().find("disruptions"s);
+    if (disruptions_ptr != requests.AsDict().end()) {
+        transport_router.SetDisruptions(ParseDisruptions(disruptions_ptr->second));
+    }
+
+    PrintResponses(json::Builder().Value(StatRequestsProcessing(catalogue, renderer, transport_router, requests.AsDict().at("stat_requests").AsArray())).Build());
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Yen's algorithm for loopless alternatives. One search over the reversed graph gives the
+// distance of every vertex to the target: it yields the first route and serves as the exact
+// A* potential of all spur searches, which banned vertices and edges can only make longer.
+template <typename Weight>
+class KShortestPathsRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using Arc = typename Graph::Arc;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    explicit KShortestPathsRouter(const Graph& graph);
+
+    // Up to count distinct loopless routes ordered by weight, the first one is optimal.
+    // Edges set in mask are skipped.
+    std::vector<RouteInfo> BuildRoutes(VertexId from, VertexId to, size_t count, const EdgeMask* mask = nullptr) const;
+
+private:
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr EdgeId NO_EDGE = detail::NO_EDGE;
+
+    struct Scratch {
+        detail::SearchScratch<Weight> to_target;
+        detail::SearchScratch<Weight> spur;
+        std::vector<uint32_t> banned_vertex;
+        std::vector<uint32_t> banned_edge;
+        uint32_t ban_epoch = 0;
+    };
+
+    static Scratch& GetScratch() {
+        static thread_local Scratch scratch;
+        return scratch;
+    }
+
+    void ComputeDistancesToTarget(Scratch& scratch, VertexId to, const EdgeMask* mask) const;
+    void StartBans(Scratch& scratch) const;
+    // Route from spur to the target avoiding banned vertices and edges, weights start at root_weight
+    std::optional<RouteInfo> BuildSpur(Scratch& scratch, VertexId spur, VertexId to, Weight root_weight,
+                                       const EdgeMask* mask) const;
+
+    const Graph& graph_;
+    // Incoming arcs by target vertex, Arc::to holds the source of the edge
+    std::vector<size_t> reverse_offsets_;
+    std::vector<Arc> reverse_arcs_;
+};
+
+template <typename Weight>
+KShortestPathsRouter<Weight>::KShortestPathsRouter(const Graph& graph)
+    : graph_(graph)
+{
+    if (!graph_.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen before routing");
+    }
+
+    reverse_offsets_.assign(graph_.GetVertexCount() + 1, 0);
+    for (const auto& edge : graph_.GetEdges()) {
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        ++reverse_offsets_[edge.to + 1];
+    }
+    for (size_t vertex = 0; vertex < graph_.GetVertexCount(); ++vertex) {
+        reverse_offsets_[vertex + 1] += reverse_offsets_[vertex];
+    }
+    reverse_arcs_.resize(graph_.GetEdgeCount());
+    std::vector<size_t> next(reverse_offsets_.begin(), reverse_offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        reverse_arcs_[next[edge.to]++] = Arc{edge.weight, static_cast<uint32_t>(edge.from), static_cast<uint32_t>(edge_id)};
+    }
+}
+
+template <typename Weight>
+void KShortestPathsRouter<Weight>::ComputeDistancesToTarget(Scratch& scratch, VertexId to, const EdgeMask* mask) const {
+    auto& search = scratch.to_target;
+    search.Prepare(graph_.GetVertexCount());
+    search.Relax(to, ZERO_WEIGHT, NO_EDGE);
+    while (!search.heap.empty()) {
+        const auto [weight, vertex] = search.PopMin();
+        if (weight > search.distance[vertex]) {
+            continue;
+        }
+        for (size_t i = reverse_offsets_[vertex]; i < reverse_offsets_[vertex + 1]; ++i) {
+            const auto& arc = reverse_arcs_[i];
+            if (!IsMasked(mask, arc.edge_id)) {
+                search.Relax(arc.to, weight + arc.weight, arc.edge_id);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+void KShortestPathsRouter<Weight>::StartBans(Scratch& scratch) const {
+    if (scratch.banned_vertex.size() < graph_.GetVertexCount()) {
+        scratch.banned_vertex.resize(graph_.GetVertexCount(), 0);
+    }
+    if (scratch.banned_edge.size() < graph_.GetEdgeCount()) {
+        scratch.banned_edge.resize(graph_.GetEdgeCount(), 0);
+    }
+    if (++scratch.ban_epoch == 0) {
+        std::fill(scratch.banned_vertex.begin(), scratch.banned_vertex.end(), 0);
+        std::fill(scratch.banned_edge.begin(), scratch.banned_edge.end(), 0);
+        scratch.ban_epoch = 1;
+    }
+}
+
+template <typename Weight>
+std::optional<typename KShortestPathsRouter<Weight>::RouteInfo> KShortestPathsRouter<Weight>::BuildSpur(
+    Scratch& scratch, VertexId spur, VertexId to, Weight root_weight, const EdgeMask* mask) const {
+    const auto& to_target = scratch.to_target;
+    auto& search = scratch.spur;
+    search.Prepare(graph_.GetVertexCount());
+
+    // The heap is keyed by weight plus the exact distance to the target, distance keeps the plain weight
+    const auto relax = [&](VertexId vertex, Weight weight, EdgeId edge_id) {
+        if (!to_target.IsReached(vertex) || (search.IsReached(vertex) && !(weight < search.distance[vertex]))) {
+            return;
+        }
+        search.stamp[vertex] = search.epoch;
+        search.distance[vertex] = weight;
+        search.prev_edge[vertex] = edge_id;
+        search.heap.push_back({weight + to_target.distance[vertex], vertex});
+        std::push_heap(search.heap.begin(), search.heap.end(), std::greater<std::pair<Weight, VertexId>>{});
+    };
+
+    relax(spur, root_weight, NO_EDGE);
+    bool found = false;
+    while (!search.heap.empty()) {
+        const auto [key, vertex] = search.PopMin();
+        const Weight weight = search.distance[vertex];
+        if (key > weight + to_target.distance[vertex]) {
+            continue;
+        }
+        if (vertex == to) {
+            found = true;
+            break;
+        }
+        for (const auto& arc : graph_.GetOutgoingArcs(vertex)) {
+            if (scratch.banned_edge[arc.edge_id] != scratch.ban_epoch && scratch.banned_vertex[arc.to] != scratch.ban_epoch
+                && !IsMasked(mask, arc.edge_id)) {
+                relax(arc.to, weight + arc.weight, arc.edge_id);
+            }
+        }
+    }
+    if (!found) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = search.prev_edge[to]; edge_id != NO_EDGE; edge_id = search.prev_edge[graph_.GetEdge(edge_id).from]) {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    return RouteInfo{search.distance[to], std::move(edges)};
+}
+
+template <typename Weight>
+std::vector<typename KShortestPathsRouter<Weight>::RouteInfo> KShortestPathsRouter<Weight>::BuildRoutes(VertexId from,
+                                                                                                      VertexId to,
+                                                                                                      size_t count,
+                                                                                                      const EdgeMask* mask) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    std::vector<RouteInfo> result;
+    auto& scratch = GetScratch();
+    ComputeDistancesToTarget(scratch, to, mask);
+    if (count == 0 || !scratch.to_target.IsReached(from)) {
+        return result;
+    }
+
+    RouteInfo first{scratch.to_target.distance[from], {}};
+    for (VertexId vertex = from; vertex != to;) {
+        const EdgeId edge_id = scratch.to_target.prev_edge[vertex];
+        first.edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).to;
+    }
+
+    // Every route remembers the position where it left its parent, spurs before it were already tried
+    std::vector<size_t> deviations{0};
+    result.push_back(std::move(first));
+    std::set<std::vector<EdgeId>> known_routes{result.front().edges};
+    std::set<std::pair<Weight, size_t>> candidates;
+    std::vector<std::pair<RouteInfo, size_t>> candidate_routes;
+
+    while (result.size() < count) {
+        const std::vector<EdgeId> last = result.back().edges;
+        Weight root_weight = ZERO_WEIGHT;
+        VertexId spur = from;
+        for (size_t i = 0; i < last.size(); ++i) {
+            if (i >= deviations.back()) {
+                StartBans(scratch);
+                for (const auto& route : result) {
+                    if (route.edges.size() > i && std::equal(last.begin(), last.begin() + i, route.edges.begin())) {
+                        scratch.banned_edge[route.edges[i]] = scratch.ban_epoch;
+                    }
+                }
+                scratch.banned_vertex[from] = scratch.ban_epoch;
+                for (size_t j = 0; j < i; ++j) {
+                    scratch.banned_vertex[graph_.GetEdge(last[j]).to] = scratch.ban_epoch;
+                }
+                scratch.banned_vertex[spur] = 0;
+
+                if (auto spur_route = BuildSpur(scratch, spur, to, root_weight, mask)) {
+                    std::vector<EdgeId> edges(last.begin(), last.begin() + i);
+                    edges.insert(edges.end(), spur_route->edges.begin(), spur_route->edges.end());
+                    if (known_routes.insert(edges).second) {
+                        candidates.insert({spur_route->weight, candidate_routes.size()});
+                        candidate_routes.push_back({RouteInfo{spur_route->weight, std::move(edges)}, i});
+                    }
+                }
+            }
+            root_weight = root_weight + graph_.GetEdge(last[i]).weight;
+            spur = graph_.GetEdge(last[i]).to;
+        }
+
+        if (candidates.empty()) {
+            break;
+        }
+        auto& [route, deviation] = candidate_routes[candidates.begin()->second];
+        candidates.erase(candidates.begin());
+        result.push_back(std::move(route));
+        deviations.push_back(deviation);
+    }
+
+    return result;
+}
+
+}  // namespace graph
@@ -10,9 +10,6 @@
 #include "domain.h"
 #include "map_renderer.pb.h"
 
-
-class SphereProjector;
-
 namespace renderer {
     struct RendererSettings
     {
@@ -47,15 +44,16 @@ namespace renderer {
         void InsertSettings(map_renderer_serialize::RenderSettings& settings);
         void InsertSettings(const renderer::RendererSettings& settings);
 
-        svg::Text RenderStopNameUnderlayer(svg::Color&, SphereProjector&, const domain::Stop*);
-        svg::Text RenderStopName(svg::Color&, SphereProjector&, const domain::Stop*);
-        svg::Circle RenderStopCircle(SphereProjector&, const domain::Stop*);
+        svg::Text RenderStopNameUnderlayer(svg::Color&, const std::vector<svg::Point>&, const domain::Stop*);
+        svg::Text RenderStopName(svg::Color&, const std::vector<svg::Point>&, const domain::Stop*);
+        svg::Circle RenderStopCircle(const std::vector<svg::Point>&, const domain::Stop*);
 
-        svg::Text RenderRouteNameUnderlayer(svg::Color&, SphereProjector&, const domain::Bus*, const domain::Stop*);
-        svg::Text RenderRouteName(svg::Color&, SphereProjector&, const domain::Bus*, const domain::Stop*);
-        svg::Polyline RenderRoutePath(svg::Color&, SphereProjector&, const domain::Bus*);
+        svg::Text RenderRouteNameUnderlayer(svg::Color&, const std::vector<svg::Point>&, const domain::Bus*, const domain::Stop*);
+        svg::Text RenderRouteName(svg::Color&, const std::vector<svg::Point>&, const domain::Bus*, const domain::Stop*);
+        svg::Polyline RenderRoutePath(svg::Color&, const std::vector<svg::Point>&, const domain::Bus*);
 
-        void RenderMap(svg::RenderContext& context, const std::vector<const domain::Bus*> routes);
+        // Stop positions are decoded from coordinates, indexed by stop id
+        void RenderMap(svg::RenderContext& context, const std::vector<const domain::Bus*> routes, const geo::CoordinateArray& coordinates);
 
         const RendererSettings& GetSettings() const;
     private:
@@ -0,0 +1,80 @@
+#include "name_arena.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace domain {
+
+	NameId NameArena::Intern(std::string_view name) {
+		const size_t hash = std::hash<std::string_view>{}(name);
+		if (!slots_.empty()) {
+			const size_t slot = FindSlot(name, hash);
+			if (slots_[slot] != EMPTY_SLOT) {
+				return slots_[slot];
+			}
+		}
+		if (names_.size() >= NO_NAME - 1) {
+			throw std::length_error("Too many names to intern");
+		}
+		if ((names_.size() + 1) * 2 > slots_.size()) {
+			Grow();
+		}
+
+		const NameId id = static_cast<NameId>(names_.size());
+		names_.push_back(Store(name));
+		hashes_.push_back(hash);
+		slots_[FindSlot(name, hash)] = id;
+		return id;
+	}
+
+	NameId NameArena::Find(std::string_view name) const {
+		if (slots_.empty()) {
+			return NO_NAME;
+		}
+		return slots_[FindSlot(name, std::hash<std::string_view>{}(name))];
+	}
+
+	std::string_view NameArena::GetName(NameId id) const {
+		return names_.at(id);
+	}
+
+	size_t NameArena::GetSize() const {
+		return names_.size();
+	}
+
+	size_t NameArena::FindSlot(std::string_view name, size_t hash) const {
+		const size_t mask = slots_.size() - 1;
+		for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+			const NameId id = slots_[slot];
+			if (id == EMPTY_SLOT || (hashes_[id] == hash && names_[id] == name)) {
+				return slot;
+			}
+		}
+	}
+
+	void NameArena::Grow() {
+		slots_.assign(std::max<size_t>(16, slots_.size() * 2), EMPTY_SLOT);
+		for (NameId id = 0; id < names_.size(); id++) {
+			slots_[FindSlot(names_[id], hashes_[id])] = id;
+		}
+	}
+
+	std::string_view NameArena::Store(std::string_view name) {
+		if (name.size() > BLOCK_SIZE) {
+			// A name longer than a block gets a block of its own, the next name starts a new one
+			blocks_.push_back(std::make_unique<char[]>(name.size()));
+			block_used_ = BLOCK_SIZE;
+			std::copy(name.begin(), name.end(), blocks_.back().get());
+			return { blocks_.back().get(),name.size() };
+		}
+		if (blocks_.empty() || name.size() > BLOCK_SIZE - block_used_) {
+			blocks_.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+			block_used_ = 0;
+		}
+		char* data = blocks_.back().get() + block_used_;
+		std::copy(name.begin(), name.end(), data);
+		block_used_ += name.size();
+		return { data,name.size() };
+	}
+}
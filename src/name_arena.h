@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace domain {
+
+	using NameId = uint32_t;
+	constexpr NameId NO_NAME = UINT32_MAX;
+
+	// Interns names: every distinct name is copied once into large character blocks and gets
+	// a dense 32-bit id. Views returned by GetName stay valid for the lifetime of the arena.
+	class NameArena {
+	public:
+		NameArena() = default;
+		NameArena(const NameArena&) = delete;
+		NameArena& operator=(const NameArena&) = delete;
+		NameArena(NameArena&&) = default;
+		NameArena& operator=(NameArena&&) = default;
+
+		// Id of the name, a new one if the name was not interned yet
+		NameId Intern(std::string_view name);
+		// NO_NAME when the name was never interned
+		NameId Find(std::string_view name) const;
+		std::string_view GetName(NameId id) const;
+		size_t GetSize() const;
+
+	private:
+		static constexpr size_t BLOCK_SIZE = 64 * 1024;
+		static constexpr NameId EMPTY_SLOT = NO_NAME;
+
+		// Slot of the name in the open-addressing table: its own one or the empty one it would take
+		size_t FindSlot(std::string_view name, size_t hash) const;
+		void Grow();
+		std::string_view Store(std::string_view name);
+
+		std::vector<std::unique_ptr<char[]>> blocks_;
+		size_t block_used_ = 0;
+
+		std::vector<std::string_view> names_;
+		std::vector<size_t> hashes_;
+		// Linear probing over a power of two slots holding name ids, at most half of them are used
+		std::vector<NameId> slots_;
+	};
+}
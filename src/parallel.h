@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+inline size_t GetThreadCount() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Calls func(index) for every index in [0, count) on up to max_threads threads, all cores by default,
+// and returns when every call is done. The order of calls is unspecified, so func must not depend on it.
+// When a call throws, the remaining indices are not started and the first exception is rethrown
+// once all threads are joined.
+template <typename Func>
+void ParallelFor(size_t count, const Func& func, size_t max_threads = GetThreadCount()) {
+    const size_t thread_count = std::min(count, max_threads);
+    if (thread_count <= 1) {
+        for (size_t index = 0; index < count; ++index) {
+            func(index);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next_index{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    const auto worker = [&next_index, count, &func, &error, &error_mutex]() {
+        try {
+            for (size_t index = next_index++; index < count; index = next_index++) {
+                func(index);
+            }
+        }
+        catch (...) {
+            next_index = count;
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}  // namespace parallel
@@ -0,0 +1,172 @@
+#include "raptor_router.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+	constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+}
+
+router::RaptorRouter::RaptorRouter(const catalogue::TransportCatalogue& catalogue, const RouterSettings& settings, const std::unordered_set<const domain::Bus*>& removed_buses)
+	:settings_(settings), stops_(catalogue.GetStops())
+{
+	route_offsets_.reserve(catalogue.GetRoutes().size() + 1);
+	route_offsets_.push_back(0);
+	std::vector<uint32_t> visit_count(stops_.size() + 1, 0);
+	for (auto bus : catalogue.GetRoutes()) {
+		if (removed_buses.count(bus)) {
+			continue;
+		}
+		route_buses_.push_back(bus);
+		const std::vector<int> segments = catalogue.GetRouteSegmentDistances(bus);
+		for (size_t i = 0; i < bus->route.size(); i++) {
+			const uint32_t stop = bus->route[i]->id;
+			route_stops_.push_back(stop);
+			route_distances_.push_back(i == 0 ? 0 : route_distances_.back() + segments[i - 1]);
+			visit_count[stop + 1]++;
+		}
+		route_offsets_.push_back(static_cast<uint32_t>(route_stops_.size()));
+	}
+
+	stop_offsets_.resize(stops_.size() + 1, 0);
+	for (size_t stop = 0; stop < stops_.size(); stop++) {
+		stop_offsets_[stop + 1] = stop_offsets_[stop] + visit_count[stop + 1];
+	}
+	stop_visits_.resize(route_stops_.size());
+	std::vector<uint32_t> next_visit(stop_offsets_.begin(), stop_offsets_.end() - 1);
+	for (uint32_t route = 0; route + 1 < route_offsets_.size(); route++) {
+		for (uint32_t position = 0; position < route_offsets_[route + 1] - route_offsets_[route]; position++) {
+			const uint32_t stop = route_stops_[route_offsets_[route] + position];
+			stop_visits_[next_visit[stop]++] = { route,position };
+		}
+	}
+}
+
+double router::RaptorRouter::GetRideTime(uint32_t route, uint32_t board_position, uint32_t alight_position) const {
+	const double distance = route_distances_[route_offsets_[route] + alight_position] - route_distances_[route_offsets_[route] + board_position];
+	return (distance / settings_.bus_velocity) / SECONDS_IN_MINUTE;
+}
+
+void router::RaptorRouter::ScanRoute(Scratch& scratch, size_t round, uint32_t route, uint32_t target) const {
+	const auto& previous = scratch.rounds[round - 1];
+	auto& current = scratch.rounds[round];
+	const uint32_t begin = route_offsets_[route];
+	const uint32_t length = route_offsets_[route + 1] - begin;
+
+	uint32_t board_position = NO_ROUTE;
+	double board_key = UNREACHED;
+	for (uint32_t position = scratch.first_marked_position[route]; position < length; position++) {
+		const uint32_t stop = route_stops_[begin + position];
+
+		if (board_position != NO_ROUTE) {
+			const uint32_t board_stop = route_stops_[begin + board_position];
+			const double arrival = previous[board_stop].arrival + settings_.bus_wait_time + GetRideTime(route, board_position, position);
+			if (arrival < scratch.best_arrival[stop] && (target == NO_STOP || arrival < scratch.best_arrival[target])) {
+				current[stop] = { arrival,route,board_position,position };
+				scratch.best_arrival[stop] = arrival;
+				if (!scratch.marked[stop]) {
+					scratch.marked[stop] = true;
+					scratch.marked_stops.push_back(stop);
+				}
+			}
+		}
+
+		// Boarding here instead of at the current stop pays off when the departure,
+		// measured against the road length from the start of the route, is earlier
+		if (previous[stop].arrival < UNREACHED) {
+			const double key = previous[stop].arrival - (route_distances_[begin + position] / settings_.bus_velocity) / SECONDS_IN_MINUTE;
+			if (key < board_key) {
+				board_key = key;
+				board_position = position;
+			}
+		}
+	}
+}
+
+router::Journey router::RaptorRouter::ExtractJourney(const Scratch& scratch, size_t round, uint32_t target) const {
+	Journey result;
+	result.total_time = scratch.rounds[round][target].arrival;
+
+	uint32_t stop = target;
+	for (size_t r = round; r > 0; r--) {
+		const Label& label = scratch.rounds[r][stop];
+		if (label.route == NO_ROUTE) {
+			continue;
+		}
+		const uint32_t board_stop = route_stops_[route_offsets_[label.route] + label.board_position];
+		result.legs.push_back({ route_buses_[label.route],stops_[board_stop],stops_[stop],
+			static_cast<int>(label.alight_position - label.board_position),GetRideTime(label.route, label.board_position, label.alight_position) });
+		stop = board_stop;
+	}
+	std::reverse(result.legs.begin(), result.legs.end());
+
+	return result;
+}
+
+void router::RaptorRouter::RunRounds(Scratch& scratch, uint32_t source, uint32_t target, std::vector<Journey>* journeys) const {
+	scratch.rounds.resize(1);
+	scratch.rounds[0].assign(stops_.size(), Label{ UNREACHED });
+	scratch.rounds[0][source].arrival = 0;
+	scratch.best_arrival.assign(stops_.size(), UNREACHED);
+	scratch.best_arrival[source] = 0;
+	scratch.marked.assign(stops_.size(), false);
+	scratch.marked_stops.assign(1, source);
+	scratch.first_marked_position.assign(route_offsets_.size() - 1, NO_ROUTE);
+
+	for (size_t round = 1; !scratch.marked_stops.empty(); round++) {
+		// Only routes through a stop improved in the previous round can improve anything,
+		// each of them is scanned from its first such stop
+		scratch.routes_to_scan.clear();
+		for (uint32_t stop : scratch.marked_stops) {
+			scratch.marked[stop] = false;
+			for (uint32_t visit = stop_offsets_[stop]; visit < stop_offsets_[stop + 1]; visit++) {
+				const auto [route, position] = stop_visits_[visit];
+				if (scratch.first_marked_position[route] == NO_ROUTE) {
+					scratch.routes_to_scan.push_back(route);
+				}
+				scratch.first_marked_position[route] = std::min(scratch.first_marked_position[route], position);
+			}
+		}
+		scratch.marked_stops.clear();
+
+		scratch.rounds.push_back(scratch.rounds[round - 1]);
+		for (auto& label : scratch.rounds[round]) {
+			label.route = NO_ROUTE;
+		}
+		for (uint32_t route : scratch.routes_to_scan) {
+			ScanRoute(scratch, round, route, target);
+			scratch.first_marked_position[route] = NO_ROUTE;
+		}
+
+		if (journeys && scratch.rounds[round][target].route != NO_ROUTE) {
+			journeys->push_back(ExtractJourney(scratch, round, target));
+		}
+	}
+}
+
+std::vector<router::Journey> router::RaptorRouter::BuildJourneys(const domain::Stop* from, const domain::Stop* to) const {
+	const uint32_t source = from->id;
+	const uint32_t target = to->id;
+
+	std::vector<Journey> result;
+	if (source == target) {
+		result.push_back({});
+		return result;
+	}
+
+	RunRounds(GetScratch(), source, target, &result);
+	return result;
+}
+
+std::vector<std::optional<double>> router::RaptorRouter::ComputeTimes(const domain::Stop* from, const std::vector<const domain::Stop*>& targets) const {
+	auto& scratch = GetScratch();
+	RunRounds(scratch, from->id, NO_STOP, nullptr);
+
+	std::vector<std::optional<double>> result;
+	result.reserve(targets.size());
+	for (auto stop : targets) {
+		const double arrival = scratch.best_arrival[stop->id];
+		result.push_back(arrival < UNREACHED ? std::optional<double>(arrival) : std::nullopt);
+	}
+	return result;
+}
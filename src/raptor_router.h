@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <unordered_set>
+#include <vector>
+
+#include "domain.h"
+#include "router_settings.h"
+#include "transport_catalogue.h"
+
+namespace router {
+
+	struct JourneyLeg {
+		const domain::Bus* bus = nullptr;
+		const domain::Stop* from = nullptr;
+		const domain::Stop* to = nullptr;
+		int span_count = 0;
+		double time = 0;
+	};
+
+	// Every leg starts with a wait of bus_wait_time at its first stop
+	struct Journey {
+		double total_time = 0;
+		std::vector<JourneyLeg> legs;
+
+		size_t GetTransferCount() const {
+			return legs.empty() ? 0 : legs.size() - 1;
+		}
+	};
+
+	// Round-based search over the catalogue's bus routes: round k finds the fastest arrivals with k rides.
+	// Nothing but the flattened routes and the stop to route incidence is kept, no graph is built.
+	class RaptorRouter {
+	public:
+		// Buses in removed_buses are left out
+		RaptorRouter(const catalogue::TransportCatalogue& catalogue, const RouterSettings& settings, const std::unordered_set<const domain::Bus*>& removed_buses = {});
+
+		// Fastest journey for every number of transfers that beats all journeys with fewer transfers,
+		// ordered by the number of transfers; empty when the stop can not be reached
+		std::vector<Journey> BuildJourneys(const domain::Stop* from, const domain::Stop* to) const;
+
+		// Fastest travel times from one stop to each of targets, nullopt for unreachable ones
+		std::vector<std::optional<double>> ComputeTimes(const domain::Stop* from, const std::vector<const domain::Stop*>& targets) const;
+
+	private:
+		static constexpr uint32_t NO_ROUTE = UINT32_MAX;
+		static constexpr uint32_t NO_STOP = UINT32_MAX;
+
+		// Arrival at a stop; route is NO_ROUTE when the label is inherited from the previous round
+		struct Label {
+			double arrival = 0;
+			uint32_t route = NO_ROUTE;
+			uint32_t board_position = 0;
+			uint32_t alight_position = 0;
+		};
+
+		struct StopVisit {
+			uint32_t route;
+			uint32_t position;
+		};
+
+		struct Scratch {
+			std::vector<std::vector<Label>> rounds;
+			std::vector<double> best_arrival;
+			std::vector<char> marked;
+			std::vector<uint32_t> marked_stops;
+			std::vector<uint32_t> first_marked_position;
+			std::vector<uint32_t> routes_to_scan;
+		};
+
+		static Scratch& GetScratch() {
+			static thread_local Scratch scratch;
+			return scratch;
+		}
+
+		double GetRideTime(uint32_t route, uint32_t board_position, uint32_t alight_position) const;
+		// Runs rounds until nothing improves; target is NO_STOP for a search to all stops
+		void RunRounds(Scratch& scratch, uint32_t source, uint32_t target, std::vector<Journey>* journeys) const;
+		void ScanRoute(Scratch& scratch, size_t round, uint32_t route, uint32_t target) const;
+		Journey ExtractJourney(const Scratch& scratch, size_t round, uint32_t target) const;
+
+		RouterSettings settings_;
+
+		// Stops are indexed by their ids
+		std::vector<const domain::Stop*> stops_;
+
+		// Stops of route r are route_stops_[route_offsets_[r] .. route_offsets_[r + 1]),
+		// route_distances_ holds the road length from the first stop of the route to each of them
+		std::vector<const domain::Bus*> route_buses_;
+		std::vector<uint32_t> route_offsets_;
+		std::vector<uint32_t> route_stops_;
+		std::vector<double> route_distances_;
+
+		// Visits of stop s are stop_visits_[stop_offsets_[s] .. stop_offsets_[s + 1])
+		std::vector<uint32_t> stop_offsets_;
+		std::vector<StopVisit> stop_visits_;
+	};
+}
@@ -10,9 +10,10 @@ const std::vector<std::string> RequestHandler::GetBusesByStop(const std::string_
     std::vector<std::string> result;
     catalogue::detail::StopInfo stop_info = db_.GetStopInfo(db_.FindStop(stop_name));
 
-    for (auto& stop : stop_info.buses)
+    result.reserve(stop_info.buses.size());
+    for (auto bus : stop_info.buses)
     {
-        result.push_back(std::string(stop));
+        result.push_back(std::string(bus->bus_name));
     }
     return result;
 }
@@ -1,145 +1,269 @@
-#pragma once
-
-#include "graph.h"
-#include "transport_router.pb.h"
-
-#include <algorithm>
-#include <cassert>
-#include <cstdint>
-#include <iterator>
-#include <optional>
-#include <stdexcept>
-#include <unordered_map>
-#include <utility>
-#include <vector>
-
-namespace graph {
-
-template <typename Weight>
-class Router {
-private:
-    using Graph = DirectedWeightedGraph<Weight>;
-    struct RouteInternalData;
-public:
-    explicit Router(const Graph& graph);
-    Router(const transport_router_serialize::RouterDataBase& db, const Graph& graph)
-        :graph_(graph)
-    {
-        std::vector<std::optional<RouteInternalData>> temp_data_vector;
-        for (auto& data_vector : db.routes_internal_data()) {
-            for (auto& data : data_vector.data()) {
-                RouteInternalData temp_data;
-                if (data.optional_data_case() == 1) {
-                    temp_data_vector.push_back({});
-                }
-                else {
-                    temp_data.weight = data.data().weight();
-                    if (data.data().prev_edge_case() == 3) {
-                        temp_data.prev_edge = data.data().edgeid();
-                    }
-                    temp_data_vector.push_back(temp_data);
-                }
-                
-            }
-            routes_internal_data_.push_back(std::move(temp_data_vector));
-        }
-        
-    }
-    struct RouteInfo {
-        Weight weight;
-        std::vector<EdgeId> edges;
-    };
-
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
-
-    const std::vector<std::vector<std::optional<RouteInternalData>>>& GetData() const {
-        return routes_internal_data_;
-    }
-
-private:
-
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
-    };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
-
-    void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
-            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                const auto& edge = graph.GetEdge(edge_id);
-                if (edge.weight < ZERO_WEIGHT) {
-                    throw std::domain_error("Edges' weights should be non-negative");
-                }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
-                }
-            }
-        }
-    }
-
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
-        }
-    }
-
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
-                }
-            }
-        }
-    }
-
-    static constexpr Weight ZERO_WEIGHT{};
-    const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
-};
-
-template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
-    : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
-{
-    InitializeRoutesInternalData(graph);
-
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
-    }
-}
-
-template <typename Weight>
-std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
-                                                                             VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
-        return std::nullopt;
-    }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
-    {
-        edges.push_back(*edge_id);
-    }
-    std::reverse(edges.begin(), edges.end());
-
-    return RouteInfo{weight, std::move(edges)};
-}
-
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+#include "transport_router.pb.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Weight kept in the all-pairs table; double routes are stored as float to halve the cell
+template <typename Weight>
+struct TableWeight {
+    using Type = Weight;
+};
+
+template <>
+struct TableWeight<double> {
+    using Type = float;
+};
+
+template <typename Weight>
+class Router {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using CellWeight = typename TableWeight<Weight>::Type;
+
+public:
+    // One cell of the row-major V x V table. Outside the diagonal NO_EDGE marks an unreachable pair,
+    // such cells also hold UNREACHABLE_WEIGHT so that relaxation needs no extra branches.
+    struct RouteInternalData {
+        CellWeight weight;
+        uint32_t prev_edge;
+    };
+
+    static constexpr uint32_t NO_EDGE = UINT32_MAX;
+    static constexpr CellWeight UNREACHABLE_WEIGHT = std::numeric_limits<CellWeight>::has_infinity
+                                                         ? std::numeric_limits<CellWeight>::infinity()
+                                                         : std::numeric_limits<CellWeight>::max() / 2;
+
+    explicit Router(const Graph& graph);
+    Router(const transport_router_serialize::RouterDataBase& db, const Graph& graph)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+    {
+        const size_t cell_count = vertex_count_ * vertex_count_;
+        const auto& weights = GetStoredWeights(db);
+        if (static_cast<size_t>(weights.size()) != cell_count
+            || static_cast<size_t>(db.prev_edges_size()) != cell_count) {
+            throw std::invalid_argument("Router table does not match the graph");
+        }
+        routes_internal_data_.resize(cell_count);
+        for (size_t i = 0; i < cell_count; ++i) {
+            routes_internal_data_[i] = {static_cast<CellWeight>(weights.Get(i)), db.prev_edges(i)};
+        }
+    }
+
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    // Weight of the shortest route without restoring its edges
+    std::optional<Weight> GetWeight(VertexId from, VertexId to) const {
+        if (from >= vertex_count_ || to >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (!IsReachable(from, to)) {
+            return std::nullopt;
+        }
+        return static_cast<Weight>(Cell(from, to).weight);
+    }
+
+    const std::vector<RouteInternalData>& GetData() const {
+        return routes_internal_data_;
+    }
+
+private:
+    static const auto& GetStoredWeights(const transport_router_serialize::RouterDataBase& db) {
+        if constexpr (std::is_integral_v<CellWeight>) {
+            return db.integer_weights();
+        }
+        else {
+            return db.weights();
+        }
+    }
+
+    RouteInternalData& Cell(VertexId from, VertexId to) {
+        return routes_internal_data_[from * vertex_count_ + to];
+    }
+    const RouteInternalData& Cell(VertexId from, VertexId to) const {
+        return routes_internal_data_[from * vertex_count_ + to];
+    }
+    bool IsReachable(VertexId from, VertexId to) const {
+        return from == to || Cell(from, to).prev_edge != NO_EDGE;
+    }
+
+    void InitializeRoutesInternalData(const Graph& graph) {
+        if (graph.GetEdgeCount() >= NO_EDGE) {
+            throw std::length_error("Too many edges for the router table");
+        }
+        routes_internal_data_.assign(vertex_count_ * vertex_count_, RouteInternalData{UNREACHABLE_WEIGHT, NO_EDGE});
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            Cell(vertex, vertex).weight = ZERO_WEIGHT;
+            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+                const auto& edge = graph.GetEdge(edge_id);
+                if (edge.weight < Weight{}) {
+                    throw std::domain_error("Edges' weights should be non-negative");
+                }
+                if (edge.to == vertex) {
+                    continue;
+                }
+                auto& route_internal_data = Cell(vertex, edge.to);
+                const CellWeight weight = static_cast<CellWeight>(edge.weight);
+                if (route_internal_data.prev_edge == NO_EDGE || route_internal_data.weight > weight) {
+                    route_internal_data = RouteInternalData{weight, static_cast<uint32_t>(edge_id)};
+                }
+            }
+        }
+    }
+
+    // Routes to and from the vertices of the current pivot tile as the plain k-i-j loop sees them
+    // at the step of each vertex: neither changes during its own step, since the diagonal stays zero
+    struct PivotSnapshot {
+        VertexId begin = 0;
+        VertexId end = 0;
+        // Route (begin + step, to) is rows[step * vertex_count_ + to]
+        std::vector<RouteInternalData> rows;
+        // Route (from, begin + step) is columns[from * TILE_SIZE + step]
+        std::vector<RouteInternalData> columns;
+    };
+
+    // Relaxes the tile of rows [from_begin, from_end) x columns [to_begin, to_end) through the pivot
+    // vertices one step at a time. A tile holding part of the pivot rows or columns records it in
+    // the snapshot at the start of each step, all other tiles read the pivot routes from there.
+    // So every cell gets the same candidates in the same order as in the plain k-i-j loop, and the
+    // table is bit-identical to it.
+    void RelaxTile(PivotSnapshot& pivot, VertexId from_begin, VertexId from_end, VertexId to_begin, VertexId to_end,
+                   bool records_rows, bool records_columns) {
+        for (VertexId vertex_through = pivot.begin; vertex_through < pivot.end; ++vertex_through) {
+            const size_t step = vertex_through - pivot.begin;
+            RouteInternalData* row_through = &pivot.rows[step * vertex_count_];
+            if (records_rows) {
+                std::copy(&Cell(vertex_through, to_begin), &Cell(vertex_through, to_begin) + (to_end - to_begin),
+                          row_through + to_begin);
+            }
+            if (records_columns) {
+                for (VertexId vertex_from = from_begin; vertex_from < from_end; ++vertex_from) {
+                    pivot.columns[vertex_from * TILE_SIZE + step] = Cell(vertex_from, vertex_through);
+                }
+            }
+            for (VertexId vertex_from = from_begin; vertex_from < from_end; ++vertex_from) {
+                const RouteInternalData route_from = pivot.columns[vertex_from * TILE_SIZE + step];
+                if (vertex_from == vertex_through || !(route_from.weight < UNREACHABLE_WEIGHT)) {
+                    continue;
+                }
+                RouteInternalData* row_from = &routes_internal_data_[vertex_from * vertex_count_];
+                // Unreachable cells never win, and the only route_to without prev_edge is the diagonal cell
+                // which can not improve (from, through) itself, so the loop is branch-free and vectorizes
+                for (VertexId vertex_to = to_begin; vertex_to < to_end; ++vertex_to) {
+                    const RouteInternalData current = row_from[vertex_to];
+                    const RouteInternalData route_to = row_through[vertex_to];
+                    const CellWeight candidate_weight = route_from.weight + route_to.weight;
+                    const bool better = candidate_weight < current.weight;
+                    row_from[vertex_to] = RouteInternalData{better ? candidate_weight : current.weight,
+                                                            better ? route_to.prev_edge : current.prev_edge};
+                }
+            }
+        }
+    }
+
+    // Blocked Floyd-Warshall: for every diagonal tile the tile itself is relaxed first, then its
+    // row and column of tiles, then all other tiles. Tiles of one phase do not depend on each
+    // other and run in parallel; every tile is written by one thread, so the table does not
+    // depend on the number of threads.
+    void RelaxRoutesInternalData() {
+        const size_t tile_count = (vertex_count_ + TILE_SIZE - 1) / TILE_SIZE;
+        const auto tile_begin = [](size_t tile) {
+            return tile * TILE_SIZE;
+        };
+        const auto tile_end = [this](size_t tile) {
+            return std::min(vertex_count_, (tile + 1) * TILE_SIZE);
+        };
+
+        PivotSnapshot pivot;
+        pivot.rows.resize(TILE_SIZE * vertex_count_);
+        pivot.columns.resize(vertex_count_ * TILE_SIZE);
+        for (size_t through = 0; through < tile_count; ++through) {
+            pivot.begin = tile_begin(through);
+            pivot.end = tile_end(through);
+
+            RelaxTile(pivot, pivot.begin, pivot.end, pivot.begin, pivot.end, true, true);
+
+            parallel::ParallelFor(2 * tile_count, [&](size_t index) {
+                const size_t tile = index / 2;
+                if (tile == through) {
+                    return;
+                }
+                if (index % 2 == 0) {
+                    RelaxTile(pivot, pivot.begin, pivot.end, tile_begin(tile), tile_end(tile), true, false);
+                }
+                else {
+                    RelaxTile(pivot, tile_begin(tile), tile_end(tile), pivot.begin, pivot.end, false, true);
+                }
+            });
+
+            parallel::ParallelFor(tile_count * tile_count, [&](size_t index) {
+                const size_t from = index / tile_count;
+                const size_t to = index % tile_count;
+                if (from == through || to == through) {
+                    return;
+                }
+                RelaxTile(pivot, tile_begin(from), tile_end(from), tile_begin(to), tile_end(to), false, false);
+            });
+        }
+    }
+
+    // 64 x 64 cells of 8 bytes: the three tiles a relaxation touches take 96 KB and fit in L2
+    static constexpr size_t TILE_SIZE = 64;
+    static constexpr CellWeight ZERO_WEIGHT{};
+    const Graph& graph_;
+    size_t vertex_count_ = 0;
+    std::vector<RouteInternalData> routes_internal_data_;
+};
+
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+{
+    InitializeRoutesInternalData(graph);
+    RelaxRoutesInternalData();
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
+                                                                             VertexId to) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (!IsReachable(from, to)) {
+        return std::nullopt;
+    }
+    const Weight weight = static_cast<Weight>(Cell(from, to).weight);
+    std::vector<EdgeId> edges;
+    for (uint32_t edge_id = Cell(from, to).prev_edge;
+         edge_id != NO_EDGE;
+         edge_id = Cell(from, graph_.GetEdge(edge_id).from).prev_edge)
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{weight, std::move(edges)};
+}
+
 }  // namespace graph
\ No newline at end of file
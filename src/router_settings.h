@@ -0,0 +1,38 @@
+#pragma once
+
+namespace router {
+
+	const int SECONDS_IN_MINUTE = 60;
+	// Integer edge weights count whole milliseconds
+	const int MILLISECONDS_IN_MINUTE = 60000;
+
+	enum class RouterEngine {
+		FLOYD_WARSHALL,
+		DIJKSTRA,
+		CONTRACTION_HIERARCHIES,
+		A_STAR,
+		RAPTOR
+	};
+
+	// SPAN_EDGES links every pair of stops of a bus by one ride edge, ROUTE_PATTERN gives every
+	// stop of a bus its own vertex and chains them, so the graph is linear in the routes' length
+	enum class GraphModel {
+		SPAN_EDGES,
+		ROUTE_PATTERN
+	};
+
+	struct RouterSettings
+	{
+		int bus_wait_time = 0;
+		double bus_velocity = 0;
+		RouterEngine engine = RouterEngine::FLOYD_WARSHALL;
+		GraphModel graph_model = GraphModel::SPAN_EDGES;
+		// Floyd-Warshall and Dijkstra search a copy of the graph with integer weights,
+		// reported times are still summed from the edges in minutes
+		bool integer_weights = false;
+		// Meters per second, the speed of footpaths and of walks to and from points
+		double walk_velocity = 0;
+		// Stops at most this many meters apart are joined by footpaths, none when 0
+		double footpath_radius = 0;
+	};
+}
\ No newline at end of file
@@ -1,25 +1,27 @@
-#pragma once
-#include <fstream>
-#include <iostream>
-
-#include "transport_catalogue.h"
-#include "transport_router.h"
-#include "map_renderer.h"
-
-#include "transport_router.pb.h"
-#include "transport_catalogue.pb.h"
-
-
-struct IndexBook
-{
-	std::map<std::string_view, int> stop_to_index;
-	std::map<std::string_view, int> bus_to_index;
-};
-
-void SetStops(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::TransportCatalogue& db, IndexBook& book);
-void SetBuses(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::TransportCatalogue& db, IndexBook& book);
-void SetStopToBuses(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::TransportCatalogue& db, IndexBook& book);
-void SetDistances(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::TransportCatalogue& db, IndexBook& book);
-void SerializeTransportCatalogue(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::DataBase& db, IndexBook& book);
-void SerializeMapRenderSettings(const renderer::MapRenderer& renderer, transport_catalogue_serialize::DataBase& db);
+#pragma once
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+#include "map_renderer.h"
+
+#include "transport_router.pb.h"
+#include "transport_catalogue.pb.h"
+
+
+struct IndexBook
+{
+	// Stops and buses are stored under their ids, edges refer to buses by name
+	std::unordered_map<domain::NameId, int> bus_to_index;
+};
+
+void SetStops(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::TransportCatalogue& db);
+void SetBuses(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::TransportCatalogue& db, IndexBook& book);
+void SetStopToBuses(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::TransportCatalogue& db);
+void SetDistances(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::TransportCatalogue& db);
+void SerializeTransportCatalogue(const catalogue::TransportCatalogue& catalogue, transport_catalogue_serialize::DataBase& db, IndexBook& book);
+void SerializeMapRenderSettings(const renderer::MapRenderer& renderer, transport_catalogue_serialize::DataBase& db);
+void SerializeTransportRouter(const router::TransportRouter& router, transport_catalogue_serialize::DataBase& db, IndexBook& book);
 void SerializeDataBase(const catalogue::TransportCatalogue& catalogue, const renderer::MapRenderer& renderer, const router::TransportRouter& router, std::string filename);
\ No newline at end of file
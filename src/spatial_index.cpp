@@ -0,0 +1,219 @@
+#define _USE_MATH_DEFINES
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace geo {
+
+namespace {
+
+constexpr double EARTH_RADIUS = 6371000;
+constexpr double DEGREE = M_PI / 180.0;
+constexpr size_t POINTS_PER_CELL = 2;
+
+}  // namespace
+
+SpatialIndex::SpatialIndex(const CoordinateArray& points)
+    : coordinates_(points.IsCompact()) {
+    const size_t count = points.GetSize();
+    if (count == 0) {
+        return;
+    }
+
+    min_ = max_ = points.Get(0);
+    for (size_t i = 1; i < count; ++i) {
+        const Coordinates point = points.Get(i);
+        min_ = {std::min(min_.lat, point.lat), std::min(min_.lng, point.lng)};
+        max_ = {std::max(max_.lat, point.lat), std::max(max_.lng, point.lng)};
+    }
+    min_cos_ = std::cos(std::max(std::abs(min_.lat), std::abs(max_.lat)) * DEGREE);
+
+    // Cells are about square on the ground
+    const double height = max_.lat - min_.lat;
+    const double width = (max_.lng - min_.lng) * std::cos((min_.lat + max_.lat) / 2 * DEGREE);
+    const size_t cell_count = std::max<size_t>(1, count / POINTS_PER_CELL);
+    if (height > 0 && width > 0) {
+        rows_ = std::clamp<size_t>(static_cast<size_t>(std::round(std::sqrt(cell_count * height / width))), 1, cell_count);
+        columns_ = std::max<size_t>(1, cell_count / rows_);
+    }
+    else {
+        rows_ = height > 0 ? cell_count : 1;
+        columns_ = height > 0 ? 1 : cell_count;
+    }
+    cell_height_ = height > 0 ? height / rows_ : 1;
+    cell_width_ = max_.lng > min_.lng ? (max_.lng - min_.lng) / columns_ : 1;
+
+    std::vector<uint32_t> cells(count);
+    cell_offsets_.assign(rows_ * columns_ + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const Coordinates point = points.Get(i);
+        cells[i] = static_cast<uint32_t>(GetRow(point.lat) * columns_ + GetColumn(point.lng));
+        ++cell_offsets_[cells[i] + 1];
+    }
+    for (size_t cell = 0; cell + 1 < cell_offsets_.size(); ++cell) {
+        cell_offsets_[cell + 1] += cell_offsets_[cell];
+    }
+    ids_.resize(count);
+    std::vector<uint32_t> next(cell_offsets_.begin(), cell_offsets_.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        ids_[next[cells[i]]++] = static_cast<uint32_t>(i);
+    }
+    coordinates_.Reserve(count);
+    vectors_.Reserve(count);
+    for (uint32_t id : ids_) {
+        coordinates_.Add(points.Get(id));
+        vectors_.Add(points.Get(id));
+    }
+}
+
+size_t SpatialIndex::GetRow(double lat) const {
+    const double row = std::floor((lat - min_.lat) / cell_height_);
+    return static_cast<size_t>(std::clamp(row, 0.0, static_cast<double>(rows_ - 1)));
+}
+
+size_t SpatialIndex::GetColumn(double lng) const {
+    const double column = std::floor((lng - min_.lng) / cell_width_);
+    return static_cast<size_t>(std::clamp(column, 0.0, static_cast<double>(columns_ - 1)));
+}
+
+double SpatialIndex::GetRingBound(Coordinates point, size_t ring) const {
+    // Points further out differ from the query by more than ring cells in latitude or in longitude.
+    // A longitude difference beyond 180 degrees is shorter the other way round.
+    const double lat_delta = ring * cell_height_;
+    const double max_lng_delta = std::max(std::abs(point.lng - min_.lng), std::abs(point.lng - max_.lng));
+    const double lng_delta = std::max(0.0, std::min({ring * cell_width_, 360 - max_lng_delta, 180.0}));
+
+    // hav(distance) >= cos(lat1) * cos(lat2) * hav(lng difference)
+    const double cos_lat = std::min(min_cos_, std::cos(point.lat * DEGREE));
+    const double lng_bound = 2 * std::asin(std::min(1.0, cos_lat * std::sin(lng_delta * DEGREE / 2)));
+    return EARTH_RADIUS * std::min(lat_delta * DEGREE, lng_bound);
+}
+
+std::vector<std::pair<uint32_t, double>> SpatialIndex::FindNearest(Coordinates point, size_t count) const {
+    std::vector<std::pair<uint32_t, double>> result;
+    count = std::min(count, ids_.size());
+    if (count == 0) {
+        return result;
+    }
+
+    // Max-heap of the closest points found so far by squared chord
+    std::vector<std::pair<double, uint32_t>> best;
+    best.reserve(count + 1);
+    const UnitVector vector = ToUnitVector(point);
+    std::vector<double> chords;
+    const auto visit_cell = [&](size_t row, size_t column) {
+        const size_t cell = row * columns_ + column;
+        const uint32_t first = cell_offsets_[cell];
+        chords.resize(cell_offsets_[cell + 1] - first);
+        vectors_.ComputeSquaredChords(vector, first, chords.size(), chords.data());
+        for (size_t i = 0; i < chords.size(); ++i) {
+            const std::pair<double, uint32_t> candidate{chords[i], ids_[first + i]};
+            if (best.size() == count && !(candidate < best.front())) {
+                continue;
+            }
+            best.push_back(candidate);
+            std::push_heap(best.begin(), best.end());
+            if (best.size() > count) {
+                std::pop_heap(best.begin(), best.end());
+                best.pop_back();
+            }
+        }
+    };
+
+    // Square rings of cells around the query's cell, until nothing outside can be closer
+    const auto row = static_cast<std::ptrdiff_t>(GetRow(point.lat));
+    const auto column = static_cast<std::ptrdiff_t>(GetColumn(point.lng));
+    const auto rows = static_cast<std::ptrdiff_t>(rows_);
+    const auto columns = static_cast<std::ptrdiff_t>(columns_);
+    for (std::ptrdiff_t ring = 0; ring < std::max(rows, columns); ++ring) {
+        for (std::ptrdiff_t r = std::max<std::ptrdiff_t>(0, row - ring); r <= std::min(rows - 1, row + ring); ++r) {
+            if (r == row - ring || r == row + ring) {
+                for (std::ptrdiff_t c = std::max<std::ptrdiff_t>(0, column - ring); c <= std::min(columns - 1, column + ring); ++c) {
+                    visit_cell(r, c);
+                }
+            }
+            else {
+                if (column - ring >= 0) {
+                    visit_cell(r, column - ring);
+                }
+                if (column + ring < columns) {
+                    visit_cell(r, column + ring);
+                }
+            }
+        }
+        if (best.size() == count && ChordToDistance(best.front().first) <= GetRingBound(point, ring)) {
+            break;
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end());
+    result.reserve(best.size());
+    for (auto [chord, id] : best) {
+        result.emplace_back(id, ChordToDistance(chord));
+    }
+    return result;
+}
+
+std::vector<std::pair<uint32_t, double>> SpatialIndex::FindWithinRadius(Coordinates point, double radius) const {
+    std::vector<std::pair<uint32_t, double>> result;
+    if (ids_.empty() || radius < 0) {
+        return result;
+    }
+
+    // The circle fits into a band of latitudes, and within the band
+    // hav(distance) >= cos(lat1) * cos(lat2) * hav(lng difference) bounds the longitudes
+    const double angle = radius / EARTH_RADIUS;
+    const double lat_delta = angle / DEGREE;
+    const double cos_lat = std::cos(std::min(90.0, std::abs(point.lat) + lat_delta) * DEGREE);
+    const double sin_lng = cos_lat > 0 ? std::sin(std::min(angle, M_PI) / 2) / cos_lat : 2;
+    const double lng_delta = sin_lng < 1 ? 2 * std::asin(sin_lng) / DEGREE : 360;
+
+    size_t first_column = 0;
+    size_t last_column = columns_ - 1;
+    // A circle across the antimeridian is looked for in every column
+    if (point.lng - lng_delta >= -180 && point.lng + lng_delta <= 180) {
+        first_column = GetColumn(point.lng - lng_delta);
+        last_column = GetColumn(point.lng + lng_delta);
+    }
+    // Cells of a row are contiguous, so the chords of a row's columns are computed in one batch
+    // and only the points inside the circle pay for an arcsine
+    const UnitVector vector = ToUnitVector(point);
+    const double max_chord = DistanceToChord(radius);
+    std::vector<double> chords;
+    for (size_t row = GetRow(point.lat - lat_delta); row <= GetRow(point.lat + lat_delta); ++row) {
+        const uint32_t first = cell_offsets_[row * columns_ + first_column];
+        chords.resize(cell_offsets_[row * columns_ + last_column + 1] - first);
+        vectors_.ComputeSquaredChords(vector, first, chords.size(), chords.data());
+        for (size_t i = 0; i < chords.size(); ++i) {
+            if (chords[i] <= max_chord) {
+                result.emplace_back(ids_[first + i], ChordToDistance(chords[i]));
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<uint32_t> SpatialIndex::FindInBox(Coordinates min, Coordinates max) const {
+    std::vector<uint32_t> result;
+    if (ids_.empty() || min.lat > max.lat || min.lng > max.lng) {
+        return result;
+    }
+
+    for (size_t row = GetRow(min.lat); row <= GetRow(max.lat); ++row) {
+        for (size_t column = GetColumn(min.lng); column <= GetColumn(max.lng); ++column) {
+            const size_t cell = row * columns_ + column;
+            for (uint32_t i = cell_offsets_[cell]; i < cell_offsets_[cell + 1]; ++i) {
+                const Coordinates coordinates = coordinates_.Get(i);
+                if (coordinates.lat >= min.lat && coordinates.lat <= max.lat && coordinates.lng >= min.lng && coordinates.lng <= max.lng) {
+                    result.push_back(ids_[i]);
+                }
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+}  // namespace geo
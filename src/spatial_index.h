@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "geo.h"
+
+namespace geo {
+
+// Static uniform grid over points, built once from their coordinates. A point's id is its
+// position in the input array. Cells hold about two points each and are stored contiguously,
+// so a query visits only the cells around the point or inside the box.
+class SpatialIndex {
+public:
+    SpatialIndex() = default;
+    explicit SpatialIndex(const CoordinateArray& points);
+
+    // Up to count points closest to point by ChordToDistance, ordered by distance in meters, ties by id
+    std::vector<std::pair<uint32_t, double>> FindNearest(Coordinates point, size_t count) const;
+    // Points within radius meters of point by ChordToDistance with their distances, ordered by id
+    std::vector<std::pair<uint32_t, double>> FindWithinRadius(Coordinates point, double radius) const;
+    // Ids of the points with min.lat <= lat <= max.lat and min.lng <= lng <= max.lng, ascending
+    std::vector<uint32_t> FindInBox(Coordinates min, Coordinates max) const;
+
+    size_t GetSize() const {
+        return ids_.size();
+    }
+
+private:
+    // Cells of coordinates outside the grid are clamped to its border
+    size_t GetRow(double lat) const;
+    size_t GetColumn(double lng) const;
+    // No point outside the square ring of cells at the given distance from the query's cell is closer than this
+    double GetRingBound(Coordinates point, size_t ring) const;
+
+    Coordinates min_{0, 0};
+    Coordinates max_{0, 0};
+    double cell_height_ = 1;
+    double cell_width_ = 1;
+    size_t rows_ = 0;
+    size_t columns_ = 0;
+    // Smallest cosine of a latitude inside the grid, scales longitude differences to distances
+    double min_cos_ = 1;
+
+    // Points of cell (row, column) are at positions [cell_offsets_[row * columns_ + column] .. cell_offsets_[row * columns_ + column + 1]),
+    // distances to the points of a cell are computed in one batch over vectors_
+    std::vector<uint32_t> cell_offsets_;
+    std::vector<uint32_t> ids_;
+    // Compact when the input is, box queries decode the points they scan
+    CoordinateArray coordinates_;
+    UnitVectors vectors_;
+};
+
+}  // namespace geo
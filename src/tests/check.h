@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Stops the test with the failed condition and its location
+#define CHECK(condition)                                                                          \
+    do {                                                                                          \
+        if (!(condition)) {                                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            std::exit(1);                                                                         \
+        }                                                                                         \
+    } while (false)
+
+// Runs a test function and reports its name once it passes
+#define RUN_TEST(test)                                 \
+    do {                                               \
+        test();                                        \
+        std::cerr << #test << " OK" << std::endl;      \
+    } while (false)
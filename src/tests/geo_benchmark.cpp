@@ -0,0 +1,78 @@
+#include "geo.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Times the distances of consecutive stops computed one by one with the acos formula, one by one
+// with the chord kernel and in a batch with UnitVectors::ComputeDistances, as stop distances of buses
+// are computed. Usage: geo_benchmark [point_count] [repeat_count]
+
+namespace {
+
+template <typename Func>
+double MeasureSeconds(Func func) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t point_count = argc > 1 ? std::stoul(argv[1]) : 100000;
+    const size_t repeat_count = argc > 2 ? std::stoul(argv[2]) : 100;
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<double> latitude(55.6, 55.9);
+    std::uniform_real_distribution<double> longitude(37.4, 37.8);
+    std::vector<geo::Coordinates> points(point_count);
+    geo::UnitVectors vectors;
+    vectors.Reserve(point_count);
+    for (auto& point : points) {
+        point = {latitude(generator), longitude(generator)};
+        vectors.Add(point);
+    }
+    std::vector<uint32_t> ids(point_count);
+    for (size_t i = 0; i < point_count; ++i) {
+        ids[i] = static_cast<uint32_t>(i);
+    }
+    const size_t pair_count = point_count - 1;
+
+    // Sums of the distances keep the loops from being optimized away
+    double acos_total = 0;
+    const double acos_seconds = MeasureSeconds([&] {
+        for (size_t repeat = 0; repeat < repeat_count; ++repeat) {
+            for (size_t i = 0; i < pair_count; ++i) {
+                acos_total += geo::ComputeDistance(points[i], points[i + 1]);
+            }
+        }
+    });
+    double chord_total = 0;
+    const double chord_seconds = MeasureSeconds([&] {
+        for (size_t repeat = 0; repeat < repeat_count; ++repeat) {
+            for (size_t i = 0; i < pair_count; ++i) {
+                chord_total += geo::ChordToDistance(geo::ComputeSquaredChord(vectors.Get(i), vectors.Get(i + 1)));
+            }
+        }
+    });
+    double batch_total = 0;
+    const double batch_seconds = MeasureSeconds([&] {
+        for (size_t repeat = 0; repeat < repeat_count; ++repeat) {
+            for (double distance : vectors.ComputeDistances(ids.data(), ids.data() + 1, pair_count)) {
+                batch_total += distance;
+            }
+        }
+    });
+
+    const double pairs = static_cast<double>(pair_count * repeat_count);
+    std::cout << pair_count << " pairs, " << repeat_count << " repeats\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "acos ComputeDistance:          " << acos_seconds / pairs * 1e9 << " ns per pair, total " << acos_total / repeat_count << " m\n";
+    std::cout << "scalar chord kernel:           " << chord_seconds / pairs * 1e9 << " ns per pair, total " << chord_total / repeat_count << " m\n";
+    std::cout << "UnitVectors::ComputeDistances: " << batch_seconds / pairs * 1e9 << " ns per pair, total " << batch_total / repeat_count << " m\n";
+}
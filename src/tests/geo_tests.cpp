@@ -0,0 +1,330 @@
+#include "geo.h"
+#include "spatial_index.h"
+#include "tests/check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr size_t POINT_COUNT = 20000;
+constexpr long double EARTH_RADIUS = 6371000;
+
+// Haversine formula in long double, the reference for the distances of the chord kernel
+double ComputeReferenceDistance(geo::Coordinates from, geo::Coordinates to) {
+    const long double dr = 3.141592653589793238462643383279502884L / 180;
+    const long double half_lat = (static_cast<long double>(to.lat) - from.lat) * dr / 2;
+    const long double half_lng = (static_cast<long double>(to.lng) - from.lng) * dr / 2;
+    const long double h = std::sin(half_lat) * std::sin(half_lat)
+        + std::cos(from.lat * dr) * std::cos(to.lat * dr) * std::sin(half_lng) * std::sin(half_lng);
+    return static_cast<double>(2 * EARTH_RADIUS * std::asin(std::min(1.0L, std::sqrt(h))));
+}
+
+double ComputeChordDistance(geo::Coordinates from, geo::Coordinates to) {
+    return geo::ChordToDistance(geo::ComputeSquaredChord(geo::ToUnitVector(from), geo::ToUnitVector(to)));
+}
+
+// Pairs anywhere on the globe and pairs a few centimeters to a few kilometers apart
+std::vector<std::pair<geo::Coordinates, geo::Coordinates>> MakeRandomPairs(uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> latitude(-90, 90);
+    std::uniform_real_distribution<double> longitude(-180, 180);
+    std::uniform_real_distribution<double> exponent(-7, -1);
+    std::uniform_real_distribution<double> direction(-1, 1);
+
+    std::vector<std::pair<geo::Coordinates, geo::Coordinates>> result;
+    for (size_t i = 0; i < POINT_COUNT; ++i) {
+        const geo::Coordinates from{latitude(generator), longitude(generator)};
+        result.push_back({from, {latitude(generator), longitude(generator)}});
+        const double offset = std::pow(10.0, exponent(generator));
+        const geo::Coordinates near{std::max(-90.0, std::min(90.0, from.lat + offset * direction(generator))),
+                                    from.lng + offset * direction(generator)};
+        result.push_back({from, near});
+    }
+    return result;
+}
+
+void TestChordMatchesReference() {
+    for (const auto& [from, to] : MakeRandomPairs(1)) {
+        const double expected = ComputeReferenceDistance(from, to);
+        // Micrometers for close points, a couple of millimeters across the globe
+        CHECK(std::abs(ComputeChordDistance(from, to) - expected) <= 1e-6 + 1e-10 * expected);
+    }
+}
+
+void TestChordMatchesAcos() {
+    for (const auto& [from, to] : MakeRandomPairs(2)) {
+        const double distance = ComputeChordDistance(from, to);
+        // acos is only accurate to decimeters for close points
+        if (distance > 1000) {
+            CHECK(std::abs(distance - geo::ComputeDistance(from, to)) <= 1e-3);
+        }
+    }
+}
+
+void TestCoincidingPoints() {
+    for (const geo::Coordinates point : {geo::Coordinates{55.611087, 37.20829}, geo::Coordinates{90, 0},
+                                         geo::Coordinates{-90, 180}, geo::Coordinates{0, -180}}) {
+        const geo::UnitVector vector = geo::ToUnitVector(point);
+        CHECK(geo::ComputeSquaredChord(vector, vector) == 0);
+        CHECK(geo::ChordToDistance(0) == 0);
+    }
+}
+
+void TestBatchMatchesScalar() {
+    const auto pairs = MakeRandomPairs(3);
+    geo::UnitVectors vectors;
+    std::vector<uint32_t> from;
+    std::vector<uint32_t> to;
+    for (const auto& [lhs, rhs] : pairs) {
+        from.push_back(static_cast<uint32_t>(vectors.GetSize()));
+        vectors.Add(lhs);
+        to.push_back(static_cast<uint32_t>(vectors.GetSize()));
+        vectors.Add(rhs);
+    }
+
+    const std::vector<double> distances = vectors.ComputeDistances(from.data(), to.data(), pairs.size());
+    CHECK(distances.size() == pairs.size());
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        CHECK(std::abs(distances[i] - ComputeChordDistance(pairs[i].first, pairs[i].second)) <= 1e-9 * std::max(1.0, distances[i]));
+    }
+
+    std::vector<double> chords(vectors.GetSize());
+    const geo::UnitVector point = geo::ToUnitVector(pairs.front().first);
+    vectors.ComputeSquaredChords(point, 0, chords.size(), chords.data());
+    for (size_t i = 0; i < chords.size(); ++i) {
+        CHECK(std::abs(chords[i] - geo::ComputeSquaredChord(point, vectors.Get(i))) <= 1e-15);
+    }
+}
+
+void TestDistanceToChordInverts() {
+    for (double distance = 0.01; distance < 2e7; distance *= 1.5) {
+        CHECK(std::abs(geo::ChordToDistance(geo::DistanceToChord(distance)) - distance) <= 1e-6 + 1e-10 * distance);
+    }
+    CHECK(geo::DistanceToChord(1e8) == 4);
+}
+
+bool operator==(geo::CompactCoordinates lhs, geo::CompactCoordinates rhs) {
+    return lhs.lat == rhs.lat && lhs.lng == rhs.lng;
+}
+
+// Decoding and encoding again gives the same microdegrees, the decoded point is within MAX_COMPACT_ERROR
+void CheckCompactRoundTrip(geo::Coordinates point) {
+    const geo::CompactCoordinates compact = geo::ToCompact(point);
+    const geo::Coordinates decoded = geo::FromCompact(compact);
+    CHECK(ComputeChordDistance(point, decoded) <= geo::MAX_COMPACT_ERROR);
+    CHECK(geo::ToCompact(decoded) == compact);
+}
+
+void TestCompactPolesAndAntimeridian() {
+    for (double lat : {-90.0, -89.9999996, 89.9999996, 90.0}) {
+        for (double lng : {-180.0, -179.9999996, 0.0, 179.9999996, 180.0}) {
+            CheckCompactRoundTrip({lat, lng});
+        }
+    }
+    for (double lat = -90; lat <= 90; lat += 0.25) {
+        CheckCompactRoundTrip({lat, -180});
+        CheckCompactRoundTrip({lat, 180});
+        CheckCompactRoundTrip({lat, std::nextafter(180.0, 0.0)});
+    }
+    CHECK(geo::ToCompact({90, 180}) == (geo::CompactCoordinates{90000000, 180000000}));
+    CHECK(geo::ToCompact({-90, -180}) == (geo::CompactCoordinates{-90000000, -180000000}));
+}
+
+void TestCompactRandomPoints() {
+    std::mt19937 generator(4);
+    std::uniform_real_distribution<double> latitude(-90, 90);
+    std::uniform_real_distribution<double> longitude(-180, 180);
+    // Halves of a microdegree are where rounding is decided
+    std::uniform_int_distribution<int32_t> microdegrees(-90000000, 90000000);
+    geo::CoordinateArray points(true);
+    std::vector<geo::Coordinates> expected;
+    for (size_t i = 0; i < POINT_COUNT; ++i) {
+        const geo::Coordinates point{latitude(generator), longitude(generator)};
+        CheckCompactRoundTrip(point);
+        CheckCompactRoundTrip({(microdegrees(generator) + 0.5) / geo::MICRODEGREES_IN_DEGREE,
+                               (2 * microdegrees(generator) + 0.5) / geo::MICRODEGREES_IN_DEGREE});
+        points.Add(point);
+        expected.push_back(geo::FromCompact(geo::ToCompact(point)));
+    }
+
+    CHECK(points.IsCompact());
+    CHECK(points.GetSize() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        CHECK(points.Get(i) == expected[i]);
+    }
+
+    // Microdegrees read from a base go in and out unchanged, a plain array decodes them
+    geo::CoordinateArray loaded(true);
+    geo::CoordinateArray plain(false);
+    for (size_t i = 0; i < points.GetSize(); ++i) {
+        loaded.Add(points.GetCompact(i));
+        plain.Add(points.GetCompact(i));
+    }
+    for (size_t i = 0; i < points.GetSize(); ++i) {
+        CHECK(loaded.GetCompact(i) == points.GetCompact(i));
+        CHECK(plain.Get(i) == expected[i]);
+    }
+}
+
+// Points of a city, around the north pole, on both sides of the antimeridian and over the whole globe,
+// the last ones with a few exact duplicates
+std::vector<std::vector<geo::Coordinates>> MakeSpatialDataSets(uint32_t seed) {
+    std::mt19937 generator(seed);
+    const auto make = [&generator](double min_lat, double max_lat, double min_lng, double max_lng, size_t count) {
+        std::uniform_real_distribution<double> latitude(min_lat, max_lat);
+        std::uniform_real_distribution<double> longitude(min_lng, max_lng);
+        std::vector<geo::Coordinates> points;
+        for (size_t i = 0; i < count; ++i) {
+            points.push_back({latitude(generator), longitude(generator)});
+        }
+        return points;
+    };
+
+    std::vector<std::vector<geo::Coordinates>> result;
+    result.push_back(make(55.6, 55.9, 37.4, 37.8, 2000));
+    result.push_back(make(89.9, 90, -180, 180, 1000));
+    result.back().push_back({90, 0});
+    auto antimeridian = make(-10.05, -9.95, 179.95, 180, 500);
+    for (auto point : make(-10.05, -9.95, -180, -179.95, 500)) {
+        antimeridian.push_back(point);
+    }
+    result.push_back(std::move(antimeridian));
+    result.push_back(make(-90, 90, -180, 180, 1500));
+    for (size_t i = 0; i < 20; ++i) {
+        result.back().push_back(result.back()[i * 7]);
+    }
+    // Degenerate grids: a single point and points along one parallel
+    result.push_back({{55.7, 37.6}});
+    result.push_back(make(55.7, 55.7, 37.4, 37.8, 100));
+    return result;
+}
+
+// Query points near the data, at the poles and on the antimeridian
+std::vector<geo::Coordinates> MakeSpatialQueries(const std::vector<geo::Coordinates>& points, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<size_t> point(0, points.size() - 1);
+    std::uniform_real_distribution<double> offset(-0.05, 0.05);
+    std::vector<geo::Coordinates> result{{90, 0}, {-90, 0}, {89.95, 180}, {-10, 180}, {-10, -180}, {-10, 179.99}, {0, 0}};
+    for (size_t i = 0; i < 100; ++i) {
+        const geo::Coordinates near = points[point(generator)];
+        result.push_back(near);
+        result.push_back({std::max(-90.0, std::min(90.0, near.lat + offset(generator))),
+                          std::max(-180.0, std::min(180.0, near.lng + offset(generator)))});
+    }
+    return result;
+}
+
+// Distances to the points as the index keeps them, the batch kernel may differ in the last bits
+std::vector<double> ComputeIndexedDistances(const geo::CoordinateArray& points, geo::Coordinates point) {
+    std::vector<double> result;
+    for (size_t i = 0; i < points.GetSize(); ++i) {
+        result.push_back(ComputeChordDistance(point, points.Get(i)));
+    }
+    return result;
+}
+
+void CheckSpatialQueries(const std::vector<geo::Coordinates>& source, bool compact, uint32_t seed) {
+    geo::CoordinateArray points(compact);
+    for (auto point : source) {
+        points.Add(point);
+    }
+    const geo::SpatialIndex index(points);
+    CHECK(index.GetSize() == points.GetSize());
+    const double tolerance = 1e-6;
+
+    for (const geo::Coordinates query : MakeSpatialQueries(source, seed)) {
+        const std::vector<double> distances = ComputeIndexedDistances(points, query);
+        std::vector<double> sorted = distances;
+        std::sort(sorted.begin(), sorted.end());
+
+        // The nearest points are the ones of brute force up to ties at the last distance
+        for (size_t count : {size_t{0}, size_t{1}, size_t{5}, size_t{40}, points.GetSize() + 1}) {
+            const auto nearest = index.FindNearest(query, count);
+            CHECK(nearest.size() == std::min(count, points.GetSize()));
+            std::vector<bool> found(points.GetSize(), false);
+            for (size_t i = 0; i < nearest.size(); ++i) {
+                const auto [id, distance] = nearest[i];
+                CHECK(id < points.GetSize() && !found[id]);
+                found[id] = true;
+                CHECK(std::abs(distance - distances[id]) <= tolerance);
+                CHECK(std::abs(distance - sorted[i]) <= tolerance);
+                CHECK(i == 0 || nearest[i - 1].second <= distance);
+            }
+        }
+
+        for (double radius : {0.0, 50.0, 1000.0, 20000.0, 500000.0, 2e7}) {
+            const auto within = index.FindWithinRadius(query, radius);
+            std::vector<bool> found(points.GetSize(), false);
+            for (size_t i = 0; i < within.size(); ++i) {
+                const auto [id, distance] = within[i];
+                CHECK(i == 0 || within[i - 1].first < id);
+                found[id] = true;
+                CHECK(std::abs(distance - distances[id]) <= tolerance);
+                CHECK(distances[id] <= radius + tolerance);
+            }
+            for (size_t id = 0; id < points.GetSize(); ++id) {
+                CHECK(found[id] || distances[id] > radius - tolerance);
+            }
+        }
+    }
+
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<size_t> point(0, points.GetSize() - 1);
+    std::uniform_real_distribution<double> size(0, 0.1);
+    for (size_t i = 0; i < 200; ++i) {
+        // Corners at stored points take the border cases, some boxes are empty or inverted
+        const geo::Coordinates corner = points.Get(point(generator));
+        geo::Coordinates min = corner;
+        geo::Coordinates max{corner.lat + size(generator), corner.lng + size(generator)};
+        if (i % 3 == 1) {
+            max = points.Get(point(generator));
+        }
+        if (i % 3 == 2) {
+            min = {corner.lat - size(generator), corner.lng - size(generator)};
+            max = corner;
+        }
+        std::vector<uint32_t> expected;
+        for (size_t id = 0; id < points.GetSize(); ++id) {
+            const geo::Coordinates stored = points.Get(id);
+            if (stored.lat >= min.lat && stored.lat <= max.lat && stored.lng >= min.lng && stored.lng <= max.lng) {
+                expected.push_back(static_cast<uint32_t>(id));
+            }
+        }
+        CHECK(index.FindInBox(min, max) == expected);
+    }
+    CHECK(index.FindInBox({-90, -180}, {90, 180}).size() == points.GetSize());
+}
+
+// Every query of the grid gives the points of brute force over the same coordinates, plain and compact
+void TestSpatialIndexMatchesBruteForce() {
+    uint32_t seed = 5;
+    for (const auto& points : MakeSpatialDataSets(seed)) {
+        for (bool compact : {false, true}) {
+            CheckSpatialQueries(points, compact, ++seed);
+        }
+    }
+
+    const geo::SpatialIndex empty{geo::CoordinateArray{}};
+    CHECK(empty.GetSize() == 0);
+    CHECK(empty.FindNearest({55.7, 37.6}, 3).empty());
+    CHECK(empty.FindWithinRadius({55.7, 37.6}, 1000).empty());
+    CHECK(empty.FindInBox({-90, -180}, {90, 180}).empty());
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestChordMatchesReference);
+    RUN_TEST(TestChordMatchesAcos);
+    RUN_TEST(TestCoincidingPoints);
+    RUN_TEST(TestBatchMatchesScalar);
+    RUN_TEST(TestDistanceToChordInverts);
+    RUN_TEST(TestCompactPolesAndAntimeridian);
+    RUN_TEST(TestCompactRandomPoints);
+    RUN_TEST(TestSpatialIndexMatchesBruteForce);
+}
@@ -0,0 +1,525 @@
+#include "a_star_router.h"
+#include "contraction_hierarchy.h"
+#include "dijkstra_router.h"
+#include "geo.h"
+#include "graph.h"
+#include "k_shortest_paths.h"
+#include "parallel.h"
+#include "router.h"
+#include "tests/check.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+constexpr size_t SEED_COUNT = 20;
+constexpr size_t QUERY_COUNT = 200;
+
+// Stops scattered over a city, each with a wait and a board vertex at the same place like in the
+// transport graph. Rides between random stops are never faster than max_speed meters per unit of weight.
+template <typename Weight>
+struct RandomCity {
+    graph::DirectedWeightedGraph<Weight> graph;
+    std::vector<geo::Coordinates> coordinates;
+};
+
+template <typename Weight>
+RandomCity<Weight> MakeRandomCity(uint32_t seed, size_t stop_count, size_t ride_count) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> latitude(55.6, 55.9);
+    std::uniform_real_distribution<double> longitude(37.4, 37.8);
+    std::uniform_real_distribution<double> slowdown(1.0, 3.0);
+    std::uniform_int_distribution<size_t> stop(0, stop_count - 1);
+    const double max_speed = 500;
+
+    RandomCity<Weight> city{graph::DirectedWeightedGraph<Weight>(2 * stop_count), {}};
+    for (size_t i = 0; i < stop_count; ++i) {
+        const geo::Coordinates point{latitude(generator), longitude(generator)};
+        city.coordinates.push_back(point);
+        city.coordinates.push_back(point);
+        city.graph.AddEdge({2 * i, 2 * i + 1, static_cast<Weight>(6)});
+    }
+    for (size_t i = 0; i < ride_count; ++i) {
+        const size_t from = stop(generator);
+        const size_t to = stop(generator);
+        const double distance = geo::ChordToDistance(
+            geo::ComputeSquaredChord(geo::ToUnitVector(city.coordinates[2 * from]), geo::ToUnitVector(city.coordinates[2 * to])));
+        const double weight = distance / max_speed * slowdown(generator);
+        city.graph.AddEdge({2 * from + 1, 2 * to, static_cast<Weight>(std::ceil(weight))});
+    }
+    city.graph.Freeze();
+    return city;
+}
+
+bool AreEqualWeights(double lhs, double rhs) {
+    return std::abs(lhs - rhs) <= 1e-9 * std::max(1.0, std::abs(rhs));
+}
+
+bool AreEqualWeights(uint32_t lhs, uint32_t rhs) {
+    return lhs == rhs;
+}
+
+// A* must find routes exactly as short as Dijkstra's, and its potential may only save work
+template <typename Weight>
+void TestAStarMatchesDijkstra() {
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        const auto city = MakeRandomCity<Weight>(seed, 150, 600);
+        const graph::DijkstraRouter<Weight> dijkstra(city.graph);
+        const graph::AStarRouter<Weight> a_star(city.graph, city.coordinates);
+        CHECK(a_star.GetMaxSpeed() > 0);
+
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<size_t> vertex(0, city.graph.GetVertexCount() - 1);
+        size_t dijkstra_settled = 0;
+        size_t a_star_settled = 0;
+        for (size_t query = 0; query < QUERY_COUNT; ++query) {
+            const graph::VertexId from = vertex(generator);
+            const graph::VertexId to = vertex(generator);
+            graph::SearchStats dijkstra_stats;
+            graph::SearchStats a_star_stats;
+            const auto expected = dijkstra.BuildRoute(from, to, &dijkstra_stats);
+            const auto route = a_star.BuildRoute(from, to, &a_star_stats);
+
+            CHECK(expected.has_value() == route.has_value());
+            CHECK(a_star_stats.settled_vertices <= city.graph.GetVertexCount());
+            if (expected) {
+                CHECK(AreEqualWeights(route->weight, expected->weight));
+                CHECK(a_star_stats.settled_vertices > 0);
+                Weight weight{};
+                for (graph::EdgeId edge_id : route->edges) {
+                    weight = weight + city.graph.GetEdge(edge_id).weight;
+                }
+                CHECK(AreEqualWeights(weight, route->weight));
+            }
+            dijkstra_settled += dijkstra_stats.settled_vertices;
+            a_star_settled += a_star_stats.settled_vertices;
+        }
+        CHECK(a_star_settled <= dijkstra_settled);
+    }
+}
+
+// Edges of a route lead from from to to one after another and add up to its weight
+template <typename Weight>
+void CheckRouteEdges(const graph::DirectedWeightedGraph<Weight>& graph, graph::VertexId from, graph::VertexId to,
+                     const typename graph::Router<Weight>::RouteInfo& route) {
+    graph::VertexId vertex = from;
+    Weight weight{};
+    for (graph::EdgeId edge_id : route.edges) {
+        const auto& edge = graph.GetEdge(edge_id);
+        CHECK(edge.from == vertex);
+        vertex = edge.to;
+        weight = weight + edge.weight;
+    }
+    CHECK(vertex == to);
+    CHECK(AreEqualWeights(weight, route.weight));
+}
+
+// The hierarchy as SerializeContractionHierarchy writes it to the base
+transport_router_serialize::ContractionHierarchyDataBase SaveHierarchy(const graph::ContractionHierarchy<double>& hierarchy) {
+    transport_router_serialize::ContractionHierarchyDataBase result;
+    for (auto rank : hierarchy.GetRanks()) {
+        result.add_rank(rank);
+    }
+    for (const auto& shortcut : hierarchy.GetShortcuts()) {
+        auto& saved = *result.add_shortcuts();
+        saved.set_from(static_cast<int>(shortcut.from));
+        saved.set_to(static_cast<int>(shortcut.to));
+        saved.set_weight(shortcut.weight);
+        saved.set_first(static_cast<int>(shortcut.first));
+        saved.set_second(static_cast<int>(shortcut.second));
+    }
+    return result;
+}
+// The all-pairs table of the plain k-i-j loop over the same initial cells as the router's
+template <typename Weight>
+std::vector<typename graph::Router<Weight>::RouteInternalData> ComputePlainTable(const graph::DirectedWeightedGraph<Weight>& graph) {
+    using Router = graph::Router<Weight>;
+    using Cell = typename Router::RouteInternalData;
+    using CellWeight = decltype(Cell::weight);
+    const size_t vertex_count = graph.GetVertexCount();
+
+    std::vector<Cell> table(vertex_count * vertex_count, Cell{Router::UNREACHABLE_WEIGHT, Router::NO_EDGE});
+    for (graph::VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        table[vertex * vertex_count + vertex].weight = CellWeight{};
+        for (graph::EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+            const auto& edge = graph.GetEdge(edge_id);
+            auto& cell = table[vertex * vertex_count + edge.to];
+            const CellWeight weight = static_cast<CellWeight>(edge.weight);
+            if (edge.to != vertex && (cell.prev_edge == Router::NO_EDGE || cell.weight > weight)) {
+                cell = Cell{weight, static_cast<uint32_t>(edge_id)};
+            }
+        }
+    }
+    for (size_t through = 0; through < vertex_count; ++through) {
+        for (size_t from = 0; from < vertex_count; ++from) {
+            const Cell route_from = table[from * vertex_count + through];
+            if (from == through || !(route_from.weight < Router::UNREACHABLE_WEIGHT)) {
+                continue;
+            }
+            for (size_t to = 0; to < vertex_count; ++to) {
+                const Cell route_to = table[through * vertex_count + to];
+                Cell& current = table[from * vertex_count + to];
+                const CellWeight candidate = route_from.weight + route_to.weight;
+                if (candidate < current.weight) {
+                    current = Cell{candidate, route_to.prev_edge};
+                }
+            }
+        }
+    }
+    return table;
+}
+
+// Weights with few distinct values make many routes of equal weight whose sums round differently
+// depending on the order of additions, so any reordering of the relaxations shows up
+template <typename Weight>
+graph::DirectedWeightedGraph<Weight> MakeTieGraph(uint32_t seed, size_t vertex_count, size_t edge_count) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<size_t> vertex(0, vertex_count - 1);
+    const std::vector<double> weights{0.1, 0.2, 0.3, 0.7, 1.1, 2.9};
+    std::uniform_int_distribution<size_t> weight(0, weights.size() - 1);
+
+    graph::DirectedWeightedGraph<Weight> result(vertex_count);
+    for (size_t i = 0; i < edge_count; ++i) {
+        const double value = weights[weight(generator)];
+        result.AddEdge({vertex(generator), vertex(generator), static_cast<Weight>(std::is_integral_v<Weight> ? value * 10 : value)});
+    }
+    return result;
+}
+
+// The blocked and parallel Floyd-Warshall must give the very table of the sequential loop, bit for bit
+template <typename Weight>
+void TestFloydWarshallMatchesPlainLoop() {
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        // Sizes off the tile boundary leave a partial last tile
+        const size_t vertex_count = 100 + seed * 13;
+        const auto graph = MakeTieGraph<Weight>(seed, vertex_count, vertex_count * (2 + seed % 4));
+        const graph::Router<Weight> router(graph);
+        const auto expected = ComputePlainTable(graph);
+
+        const auto& table = router.GetData();
+        CHECK(table.size() == expected.size());
+        for (size_t i = 0; i < table.size(); ++i) {
+            CHECK(std::memcmp(&table[i].weight, &expected[i].weight, sizeof(table[i].weight)) == 0);
+            CHECK(table[i].prev_edge == expected[i].prev_edge);
+        }
+    }
+}
+
+// The hierarchy must find routes exactly as short as Dijkstra's, built in place and loaded back from the base
+void TestContractionHierarchyMatchesDijkstra() {
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        const auto city = MakeRandomCity<double>(seed, 150, 600);
+        auto ties = MakeTieGraph<double>(seed, 120, 120 * (2 + seed % 4));
+        ties.Freeze();
+        const std::vector<const graph::DirectedWeightedGraph<double>*> graphs{&city.graph, &ties};
+        for (const auto* graph : graphs) {
+            const graph::DijkstraRouter<double> dijkstra(*graph);
+            const graph::ContractionHierarchy<double> hierarchy(*graph);
+            const graph::ContractionHierarchy<double> loaded(SaveHierarchy(hierarchy), *graph);
+
+            std::mt19937 generator(seed);
+            std::uniform_int_distribution<size_t> vertex(0, graph->GetVertexCount() - 1);
+            for (size_t query = 0; query < QUERY_COUNT; ++query) {
+                const graph::VertexId from = vertex(generator);
+                const graph::VertexId to = vertex(generator);
+                const auto expected = dijkstra.BuildRoute(from, to);
+                for (const auto* router : {&hierarchy, &loaded}) {
+                    const auto route = router->BuildRoute(from, to);
+                    CHECK(expected.has_value() == route.has_value());
+                    if (expected) {
+                        CHECK(AreEqualWeights(route->weight, expected->weight));
+                        CheckRouteEdges(*graph, from, to, *route);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// A damaged or stale base must be rejected on load instead of unpacking arcs that do not exist
+void TestContractionHierarchyRejectsDamagedBase() {
+    const auto city = MakeRandomCity<double>(1, 150, 600);
+    const graph::ContractionHierarchy<double> hierarchy(city.graph);
+    const auto base = SaveHierarchy(hierarchy);
+    CHECK(base.shortcuts_size() > 0);
+    const int vertex_count = static_cast<int>(city.graph.GetVertexCount());
+    const int own_arc = static_cast<int>(city.graph.GetEdgeCount());
+
+    const std::vector<void (*)(transport_router_serialize::Shortcut&, int, int)> damages{
+        [](auto& shortcut, int, int own_arc) { shortcut.set_first(own_arc); },
+        [](auto& shortcut, int, int own_arc) { shortcut.set_second(own_arc + 1000); },
+        [](auto& shortcut, int, int) { shortcut.set_first(-1); },
+        [](auto& shortcut, int vertex_count, int) { shortcut.set_from(vertex_count); },
+        [](auto& shortcut, int, int) { shortcut.set_to(-2); },
+        [](auto& shortcut, int, int) { shortcut.set_weight(-1); },
+        [](auto& shortcut, int, int) { shortcut.set_first(shortcut.second()); },
+    };
+    for (const auto& damage : damages) {
+        auto damaged = base;
+        damage(*damaged.mutable_shortcuts(0), vertex_count, own_arc);
+        bool rejected = false;
+        try {
+            graph::ContractionHierarchy<double> loaded(damaged, city.graph);
+        }
+        catch (const std::invalid_argument&) {
+            rejected = true;
+        }
+        CHECK(rejected);
+    }
+
+    auto short_ranks = base;
+    short_ranks.mutable_rank()->RemoveLast();
+    bool rejected = false;
+    try {
+        graph::ContractionHierarchy<double> loaded(short_ranks, city.graph);
+    }
+    catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+// Weights of all loopless routes from from to to in increasing order, found by trying every path
+template <typename Weight>
+std::vector<Weight> ComputeSimplePathWeights(const graph::DirectedWeightedGraph<Weight>& graph, graph::VertexId from,
+                                             graph::VertexId to) {
+    std::vector<Weight> result;
+    std::vector<bool> visited(graph.GetVertexCount(), false);
+    const std::function<void(graph::VertexId, Weight)> extend = [&](graph::VertexId vertex, Weight weight) {
+        if (vertex == to) {
+            result.push_back(weight);
+            return;
+        }
+        visited[vertex] = true;
+        for (graph::EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.from == vertex && !visited[edge.to]) {
+                extend(edge.to, weight + edge.weight);
+            }
+        }
+        visited[vertex] = false;
+    };
+    extend(from, Weight{});
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// Routes are valid, loopless, distinct and ordered by weight, the first one is as short as Dijkstra's.
+// On small graphs their weights are exactly the smallest ones among all loopless routes.
+void TestKShortestPathsMatchBruteForce() {
+    const size_t count = 12;
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        auto graph = MakeTieGraph<uint32_t>(seed, 8, 14 + seed % 10);
+        graph.Freeze();
+        const graph::DijkstraRouter<uint32_t> dijkstra(graph);
+        const graph::KShortestPathsRouter<uint32_t> router(graph);
+
+        for (graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+            for (graph::VertexId to = 0; to < graph.GetVertexCount(); ++to) {
+                const auto routes = router.BuildRoutes(from, to, count);
+                const auto expected = ComputeSimplePathWeights(graph, from, to);
+                CHECK(routes.size() == std::min(count, expected.size()));
+
+                const auto shortest = dijkstra.BuildRoute(from, to);
+                CHECK(shortest.has_value() == !routes.empty());
+                if (shortest) {
+                    CHECK(routes.front().weight == shortest->weight);
+                }
+                for (size_t i = 0; i < routes.size(); ++i) {
+                    CHECK(routes[i].weight == expected[i]);
+                    CheckRouteEdges(graph, from, to, routes[i]);
+                    std::vector<bool> visited(graph.GetVertexCount(), false);
+                    visited[from] = true;
+                    for (graph::EdgeId edge_id : routes[i].edges) {
+                        CHECK(!visited[graph.GetEdge(edge_id).to]);
+                        visited[graph.GetEdge(edge_id).to] = true;
+                    }
+                    for (size_t j = 0; j < i; ++j) {
+                        CHECK(routes[j].edges != routes[i].edges);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Routes through a bigger city keep the same properties, compared with Dijkstra only
+void TestKShortestPathsOnCity() {
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        const auto city = MakeRandomCity<double>(seed, 150, 600);
+        const graph::DijkstraRouter<double> dijkstra(city.graph);
+        const graph::KShortestPathsRouter<double> router(city.graph);
+
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<size_t> vertex(0, city.graph.GetVertexCount() - 1);
+        for (size_t query = 0; query < QUERY_COUNT / 4; ++query) {
+            const graph::VertexId from = vertex(generator);
+            const graph::VertexId to = vertex(generator);
+            const auto routes = router.BuildRoutes(from, to, 5);
+            const auto shortest = dijkstra.BuildRoute(from, to);
+            CHECK(shortest.has_value() == !routes.empty());
+            if (shortest) {
+                CHECK(AreEqualWeights(routes.front().weight, shortest->weight));
+            }
+            for (size_t i = 0; i < routes.size(); ++i) {
+                CheckRouteEdges(city.graph, from, to, routes[i]);
+                if (i > 0) {
+                    CHECK(!(routes[i].weight < routes[i - 1].weight));
+                    CHECK(routes[i].edges != routes[i - 1].edges);
+                }
+            }
+        }
+    }
+}
+
+void TestEdgeMask() {
+    graph::EdgeMask mask(130);
+    CHECK(mask.IsEmpty());
+    mask.Disable(0);
+    mask.Disable(129);
+    mask.Disable(129);
+    CHECK(!mask.IsEmpty());
+    CHECK(mask.IsDisabled(0) && mask.IsDisabled(129));
+    CHECK(!mask.IsDisabled(1) && !mask.IsDisabled(128));
+    // Edges past the end are enabled until the mask grows over them
+    CHECK(!mask.IsDisabled(1000));
+    mask.Resize(1001);
+    CHECK(!mask.IsDisabled(1000) && mask.IsDisabled(129));
+    mask.Disable(1000);
+    CHECK(mask.IsDisabled(1000));
+    CHECK(!graph::IsMasked(nullptr, 0));
+    CHECK(graph::IsMasked(&mask, 0));
+}
+
+// Every fourth edge or so disabled at random and the graph without them
+template <typename Weight>
+struct MaskedGraph {
+    graph::EdgeMask mask;
+    graph::DirectedWeightedGraph<Weight> remaining;
+};
+
+template <typename Weight>
+MaskedGraph<Weight> MakeMaskedGraph(const graph::DirectedWeightedGraph<Weight>& graph, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::bernoulli_distribution disabled(0.25);
+    MaskedGraph<Weight> result{graph::EdgeMask(graph.GetEdgeCount()), graph::DirectedWeightedGraph<Weight>(graph.GetVertexCount())};
+    for (graph::EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (disabled(generator)) {
+            result.mask.Disable(edge_id);
+        }
+        else {
+            result.remaining.AddEdge(graph.GetEdge(edge_id));
+        }
+    }
+    result.remaining.Freeze();
+    return result;
+}
+
+// Searches under a mask never take a disabled edge and find routes as short as in the graph without them
+void TestMaskedSearchesSkipDisabledEdges() {
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        const auto city = MakeRandomCity<double>(seed, 150, 600);
+        const auto masked = MakeMaskedGraph(city.graph, seed);
+        const graph::DijkstraRouter<double> dijkstra(city.graph);
+        const graph::AStarRouter<double> a_star(city.graph, city.coordinates);
+        const graph::DijkstraRouter<double> expected_router(masked.remaining);
+
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<size_t> vertex(0, city.graph.GetVertexCount() - 1);
+        for (size_t query = 0; query < QUERY_COUNT; ++query) {
+            const graph::VertexId from = vertex(generator);
+            const graph::VertexId to = vertex(generator);
+            const auto expected = expected_router.BuildRoute(from, to);
+            for (const auto& route : {dijkstra.BuildRoute(from, to, nullptr, &masked.mask),
+                                      a_star.BuildRoute(from, to, nullptr, &masked.mask)}) {
+                CHECK(expected.has_value() == route.has_value());
+                if (expected) {
+                    CHECK(AreEqualWeights(route->weight, expected->weight));
+                    CheckRouteEdges(city.graph, from, to, *route);
+                    for (graph::EdgeId edge_id : route->edges) {
+                        CHECK(!masked.mask.IsDisabled(edge_id));
+                    }
+                }
+            }
+        }
+    }
+
+    const size_t count = 12;
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        auto graph = MakeTieGraph<uint32_t>(seed, 8, 18 + seed % 10);
+        graph.Freeze();
+        const auto masked = MakeMaskedGraph(graph, seed);
+        const graph::KShortestPathsRouter<uint32_t> router(graph);
+        for (graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+            for (graph::VertexId to = 0; to < graph.GetVertexCount(); ++to) {
+                const auto routes = router.BuildRoutes(from, to, count, &masked.mask);
+                const auto expected = ComputeSimplePathWeights(masked.remaining, from, to);
+                CHECK(routes.size() == std::min(count, expected.size()));
+                for (size_t i = 0; i < routes.size(); ++i) {
+                    CHECK(routes[i].weight == expected[i]);
+                    CheckRouteEdges(graph, from, to, routes[i]);
+                    for (graph::EdgeId edge_id : routes[i].edges) {
+                        CHECK(!masked.mask.IsDisabled(edge_id));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Every index is visited once, and an exception of a worker reaches the caller instead of terminating.
+// Thread counts are given explicitly, so the threads run even on a single core.
+void TestParallelForRethrows() {
+    const size_t count = 10000;
+    for (size_t thread_count : {1, 2, 4, 16}) {
+        std::vector<std::atomic<int>> visits(count);
+        parallel::ParallelFor(count, [&visits](size_t index) {
+            ++visits[index];
+        }, thread_count);
+        for (const auto& visit : visits) {
+            CHECK(visit == 1);
+        }
+
+        for (size_t failing : {size_t{0}, count / 2, count - 1}) {
+            std::atomic<size_t> calls{0};
+            bool caught = false;
+            try {
+                parallel::ParallelFor(count, [&calls, failing](size_t index) {
+                    ++calls;
+                    if (index == failing) {
+                        throw std::runtime_error("failed");
+                    }
+                }, thread_count);
+            }
+            catch (const std::runtime_error&) {
+                caught = true;
+            }
+            CHECK(caught);
+            CHECK(calls <= count);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestAStarMatchesDijkstra<double>);
+    RUN_TEST(TestAStarMatchesDijkstra<uint32_t>);
+    RUN_TEST(TestFloydWarshallMatchesPlainLoop<double>);
+    RUN_TEST(TestFloydWarshallMatchesPlainLoop<uint32_t>);
+    RUN_TEST(TestParallelForRethrows);
+    RUN_TEST(TestContractionHierarchyMatchesDijkstra);
+    RUN_TEST(TestContractionHierarchyRejectsDamagedBase);
+    RUN_TEST(TestKShortestPathsMatchBruteForce);
+    RUN_TEST(TestKShortestPathsOnCity);
+    RUN_TEST(TestEdgeMask);
+    RUN_TEST(TestMaskedSearchesSkipDisabledEdges);
+}
@@ -0,0 +1,128 @@
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "router.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Times the double and the integer instantiations of Floyd-Warshall and Dijkstra on the same
+// transport-like graph, integer weights are the double ones in whole milliseconds as with
+// integer_weights. Usage: router_benchmark [stop_count] [bus_count] [query_count]
+
+namespace {
+
+constexpr double MILLISECONDS_IN_MINUTE = 60000;
+
+// Wait edges from every stop's wait vertex to its board vertex, and for every bus a ride from each
+// of its stops to every later one, like the span_edges graph model
+std::vector<graph::Edge<double>> MakeTransportEdges(size_t stop_count, size_t bus_count, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<size_t> stop(0, stop_count - 1);
+    std::uniform_int_distribution<size_t> length(5, 20);
+    std::uniform_real_distribution<double> hop_time(1.0, 6.0);
+    const double bus_wait_time = 6;
+
+    std::vector<graph::Edge<double>> edges;
+    for (size_t i = 0; i < stop_count; ++i) {
+        edges.push_back({2 * i, 2 * i + 1, bus_wait_time});
+    }
+    for (size_t bus = 0; bus < bus_count; ++bus) {
+        std::vector<size_t> route(length(generator));
+        std::vector<double> hops(route.size());
+        for (size_t i = 0; i < route.size(); ++i) {
+            route[i] = stop(generator);
+            hops[i] = hop_time(generator);
+        }
+        for (size_t from = 0; from < route.size(); ++from) {
+            double time = 0;
+            for (size_t to = from + 1; to < route.size(); ++to) {
+                time += hops[to];
+                edges.push_back({2 * route[from] + 1, 2 * route[to], time, domain::NO_NAME, static_cast<int>(to - from)});
+            }
+        }
+    }
+    return edges;
+}
+
+std::vector<graph::Edge<uint32_t>> ToIntegerEdges(const std::vector<graph::Edge<double>>& edges) {
+    std::vector<graph::Edge<uint32_t>> result;
+    result.reserve(edges.size());
+    for (const auto& edge : edges) {
+        result.push_back({edge.from, edge.to, static_cast<uint32_t>(std::round(edge.weight * MILLISECONDS_IN_MINUTE)),
+                          edge.bus_name_id, edge.span_count});
+    }
+    return result;
+}
+
+template <typename Func>
+double MeasureSeconds(Func func) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Timings {
+    double floyd_warshall = 0;
+    double dijkstra = 0;
+    // Sum of the found weights in minutes, keeps the queries from being optimized away
+    double total_minutes = 0;
+};
+
+template <typename Weight>
+Timings Run(std::vector<graph::Edge<Weight>> edges, size_t vertex_count, const std::vector<std::pair<size_t, size_t>>& queries,
+            double minutes_per_unit) {
+    graph::DirectedWeightedGraph<Weight> graph(vertex_count, std::move(edges));
+    graph.Freeze();
+
+    Timings result;
+    result.floyd_warshall = MeasureSeconds([&] {
+        const graph::Router<Weight> router(graph);
+        for (auto [from, to] : queries) {
+            if (auto weight = router.GetWeight(from, to)) {
+                result.total_minutes += static_cast<double>(*weight) * minutes_per_unit;
+            }
+        }
+    });
+    const graph::DijkstraRouter<Weight> dijkstra(graph);
+    result.dijkstra = MeasureSeconds([&] {
+        for (auto [from, to] : queries) {
+            if (auto route = dijkstra.BuildRoute(from, to)) {
+                result.total_minutes += static_cast<double>(route->weight) * minutes_per_unit;
+            }
+        }
+    });
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t stop_count = argc > 1 ? std::stoul(argv[1]) : 1000;
+    const size_t bus_count = argc > 2 ? std::stoul(argv[2]) : 200;
+    const size_t query_count = argc > 3 ? std::stoul(argv[3]) : 2000;
+
+    const auto edges = MakeTransportEdges(stop_count, bus_count, 1);
+    const size_t vertex_count = 2 * stop_count;
+    std::mt19937 generator(2);
+    std::uniform_int_distribution<size_t> stop(0, stop_count - 1);
+    std::vector<std::pair<size_t, size_t>> queries(query_count);
+    for (auto& [from, to] : queries) {
+        from = 2 * stop(generator);
+        to = 2 * stop(generator);
+    }
+
+    const Timings real = Run(edges, vertex_count, queries, 1.0);
+    const Timings integer = Run(ToIntegerEdges(edges), vertex_count, queries, 1 / MILLISECONDS_IN_MINUTE);
+
+    std::cout << vertex_count << " vertices, " << edges.size() << " edges, " << query_count << " queries\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "floyd_warshall build + lookups: double " << real.floyd_warshall << " s, uint32_t " << integer.floyd_warshall << " s\n";
+    std::cout << "dijkstra queries:               double " << real.dijkstra << " s, uint32_t " << integer.dijkstra << " s\n";
+    std::cout << "weights found, minutes:         double " << real.total_minutes << ", uint32_t " << integer.total_minutes << "\n";
+}
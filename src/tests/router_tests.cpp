@@ -0,0 +1,518 @@
+#include "geo.h"
+#include "router_settings.h"
+#include "serialization.h"
+#include "tests/check.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr size_t SEED_COUNT = 3;
+constexpr double WALK_VELOCITY = 1.4;
+
+double ComputeChordDistance(geo::Coordinates from, geo::Coordinates to) {
+    return geo::ChordToDistance(geo::ComputeSquaredChord(geo::ToUnitVector(from), geo::ToUnitVector(to)));
+}
+
+struct RandomBus {
+    std::string name;
+    // The full route as AddBusRoute takes it, back and forth unless it is a roundtrip
+    std::vector<std::string> stops;
+    bool is_roundtrip = false;
+};
+
+// Stops scattered over a city and buses between random stops, the road between two stops
+// is up to half as long again as the great circle
+struct RandomNetwork {
+    std::vector<std::pair<std::string, geo::Coordinates>> stops;
+    std::map<std::pair<std::string, std::string>, int> distances;
+    std::vector<RandomBus> buses;
+};
+
+RandomNetwork MakeRandomNetwork(uint32_t seed, size_t stop_count, size_t bus_count) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> latitude(55.70, 55.80);
+    std::uniform_real_distribution<double> longitude(37.50, 37.70);
+    std::uniform_real_distribution<double> detour(1.0, 1.5);
+    std::uniform_int_distribution<size_t> stop(0, stop_count - 1);
+    std::uniform_int_distribution<size_t> length(3, 10);
+
+    RandomNetwork result;
+    for (size_t i = 0; i < stop_count; ++i) {
+        result.stops.push_back({"Stop " + std::to_string(i), {latitude(generator), longitude(generator)}});
+    }
+    for (size_t bus = 0; bus < bus_count; ++bus) {
+        std::vector<size_t> route;
+        for (size_t i = length(generator); i > 0; --i) {
+            route.push_back(stop(generator));
+        }
+        const bool is_roundtrip = bus % 2 == 0;
+        if (is_roundtrip) {
+            route.push_back(route.front());
+        }
+        else {
+            route.insert(route.end(), route.rbegin() + 1, route.rend());
+        }
+
+        RandomBus random_bus{"Bus " + std::to_string(bus), {}, is_roundtrip};
+        for (size_t i = 0; i < route.size(); ++i) {
+            random_bus.stops.push_back(result.stops[route[i]].first);
+            if (i > 0) {
+                const double distance = ComputeChordDistance(result.stops[route[i - 1]].second, result.stops[route[i]].second);
+                result.distances.emplace(std::pair{random_bus.stops[i - 1], random_bus.stops[i]},
+                                         static_cast<int>(std::ceil(distance * detour(generator))));
+            }
+        }
+        result.buses.push_back(std::move(random_bus));
+    }
+    return result;
+}
+
+void AddBus(catalogue::TransportCatalogue& catalogue, const RandomBus& bus) {
+    catalogue.AddBusRoute(bus.name, std::vector<std::string_view>(bus.stops.begin(), bus.stops.end()), bus.is_roundtrip);
+}
+
+// All stops with their distances, then the given buses
+void FillCatalogue(catalogue::TransportCatalogue& catalogue, const RandomNetwork& network, const std::vector<RandomBus>& buses) {
+    for (const auto& [name, coordinates] : network.stops) {
+        catalogue.AddStop(name, coordinates);
+    }
+    catalogue.BuildStopIndex();
+    for (const auto& [stops, distance] : network.distances) {
+        catalogue.SetStopDistance(catalogue.FindStop(stops.first), catalogue.FindStop(stops.second), distance);
+    }
+    for (const auto& bus : buses) {
+        AddBus(catalogue, bus);
+    }
+}
+
+void FillRandomCatalogue(catalogue::TransportCatalogue& catalogue, uint32_t seed, size_t stop_count, size_t bus_count) {
+    const RandomNetwork network = MakeRandomNetwork(seed, stop_count, bus_count);
+    FillCatalogue(catalogue, network, network.buses);
+}
+
+// Every graph engine with both graph models, with and without footpaths
+std::vector<router::RouterSettings> MakeGraphSettings() {
+    std::vector<router::RouterSettings> result;
+    for (auto engine : {router::RouterEngine::FLOYD_WARSHALL, router::RouterEngine::DIJKSTRA,
+                        router::RouterEngine::CONTRACTION_HIERARCHIES, router::RouterEngine::A_STAR}) {
+        for (auto model : {router::GraphModel::SPAN_EDGES, router::GraphModel::ROUTE_PATTERN}) {
+            for (double footpath_radius : {0.0, 400.0}) {
+                router::RouterSettings settings;
+                settings.bus_wait_time = 4;
+                settings.bus_velocity = 30 * 1000.0 / 60;
+                settings.engine = engine;
+                settings.graph_model = model;
+                settings.walk_velocity = WALK_VELOCITY;
+                settings.footpath_radius = footpath_radius;
+                result.push_back(settings);
+            }
+        }
+    }
+    return result;
+}
+
+bool AreEqualTimes(double lhs, double rhs) {
+    return std::abs(lhs - rhs) <= 1e-9 * std::max(1.0, std::abs(rhs));
+}
+
+double ComputeWalkTime(double distance) {
+    return distance / WALK_VELOCITY / router::SECONDS_IN_MINUTE;
+}
+
+// Floyd-Warshall keeps its table in float, the weights of the edges are exact
+double SumWeights(const router::TransportRouter& transport_router, const graph::Router<double>::RouteInfo& route) {
+    double result = 0;
+    for (graph::EdgeId edge_id : route.edges) {
+        result += transport_router.GetEdge(edge_id).weight;
+    }
+    return result;
+}
+
+// The trip is as fast as the best of walking all the way and of every pair of access stops joined
+// by the router's own route between stops, and its parts add up
+void CheckPointRoute(router::TransportRouter& transport_router, const catalogue::TransportCatalogue& catalogue,
+                     geo::Coordinates from, geo::Coordinates to, const router::Disruptions* disruptions) {
+    const router::PointRoute route = transport_router.BuildRoute(from, to, WALK_VELOCITY, disruptions);
+
+    const double walk_time = ComputeWalkTime(ComputeChordDistance(from, to));
+    double expected = walk_time;
+    const auto from_stops = catalogue.FindNearestStops(from, 5);
+    const auto to_stops = catalogue.FindNearestStops(to, 5);
+    for (auto [from_stop, from_distance] : from_stops) {
+        for (auto [to_stop, to_distance] : to_stops) {
+            const auto ride = transport_router.BuildRoute(from_stop->Stop_name, to_stop->Stop_name, nullptr, disruptions);
+            if (ride) {
+                expected = std::min(expected, ComputeWalkTime(from_distance) + SumWeights(transport_router, *ride) + ComputeWalkTime(to_distance));
+            }
+        }
+    }
+    CHECK(AreEqualTimes(route.total_time, expected));
+
+    if (route.from_stop == nullptr) {
+        CHECK(route.to_stop == nullptr);
+        CHECK(route.route.edges.empty());
+        CHECK(AreEqualTimes(route.total_time, walk_time));
+        CHECK(AreEqualTimes(route.first_walk.time, walk_time));
+        return;
+    }
+    CHECK(route.to_stop != nullptr);
+    const auto is_access_stop = [](const auto& stops, const domain::Stop* stop) {
+        return std::any_of(stops.begin(), stops.end(), [stop](const auto& item) {
+            return item.first == stop;
+        });
+    };
+    CHECK(is_access_stop(from_stops, route.from_stop));
+    CHECK(is_access_stop(to_stops, route.to_stop));
+    CHECK(AreEqualTimes(route.first_walk.distance, ComputeChordDistance(from, catalogue.GetCoordinates(route.from_stop))));
+    CHECK(AreEqualTimes(route.last_walk.distance, ComputeChordDistance(catalogue.GetCoordinates(route.to_stop), to)));
+
+    graph::VertexId vertex = 2 * static_cast<graph::VertexId>(route.from_stop->id);
+    double weight = 0;
+    for (graph::EdgeId edge_id : route.route.edges) {
+        const auto& edge = transport_router.GetEdge(edge_id);
+        CHECK(edge.from == vertex);
+        vertex = edge.to;
+        weight += edge.weight;
+    }
+    CHECK(vertex == 2 * static_cast<graph::VertexId>(route.to_stop->id));
+    CHECK(AreEqualTimes(route.route.weight, weight));
+    CHECK(AreEqualTimes(route.total_time, route.first_walk.time + route.route.weight + route.last_walk.time));
+}
+
+void TestPointRoutesMatchBruteForce() {
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        catalogue::TransportCatalogue catalogue;
+        FillRandomCatalogue(catalogue, seed, 80, 14);
+        router::Disruptions disruptions;
+        disruptions.stops = {"Stop 1", "Stop 2", "Stop 3"};
+        disruptions.buses = {"Bus 0"};
+
+        for (const auto& settings : MakeGraphSettings()) {
+            router::TransportRouter transport_router(settings, &catalogue);
+            transport_router.BuildRouter();
+
+            std::mt19937 generator(seed);
+            std::uniform_real_distribution<double> latitude(55.68, 55.82);
+            std::uniform_real_distribution<double> longitude(37.48, 37.72);
+            std::uniform_real_distribution<double> offset(-0.001, 0.001);
+            for (size_t query = 0; query < 30; ++query) {
+                const geo::Coordinates from{latitude(generator), longitude(generator)};
+                const geo::Coordinates to{latitude(generator), longitude(generator)};
+                CheckPointRoute(transport_router, catalogue, from, to, nullptr);
+                CheckPointRoute(transport_router, catalogue, from, to, &disruptions);
+
+                // Any ride costs a wait longer than a walk of a hundred meters or so
+                const geo::Coordinates near{from.lat + offset(generator), from.lng + offset(generator)};
+                const router::PointRoute walk = transport_router.BuildRoute(from, near, WALK_VELOCITY);
+                CHECK(walk.from_stop == nullptr && walk.to_stop == nullptr);
+                CHECK(AreEqualTimes(walk.first_walk.distance, ComputeChordDistance(from, near)));
+                CheckPointRoute(transport_router, catalogue, from, near, nullptr);
+            }
+        }
+    }
+}
+
+void TestPointRoutesNeedGraphEngine() {
+    catalogue::TransportCatalogue catalogue;
+    FillRandomCatalogue(catalogue, 1, 20, 4);
+    router::RouterSettings settings;
+    settings.bus_wait_time = 4;
+    settings.bus_velocity = 500;
+    settings.engine = router::RouterEngine::RAPTOR;
+    router::TransportRouter transport_router(settings, &catalogue);
+    transport_router.BuildRouter();
+
+    bool rejected = false;
+    try {
+        transport_router.BuildRoute(geo::Coordinates{55.75, 37.6}, geo::Coordinates{55.76, 37.61}, WALK_VELOCITY);
+    }
+    catch (const std::logic_error&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+// A catalogue changed after its router was built: buses are added and removed, distances of
+// some hops of the kept buses change
+struct DeltaScenario {
+    RandomNetwork network;
+    std::vector<RandomBus> base_buses;
+    std::vector<RandomBus> added_buses;
+    std::vector<std::string> removed_buses;
+    std::map<std::pair<std::string, std::string>, int> changed_distances;
+};
+
+DeltaScenario MakeDeltaScenario(uint32_t seed) {
+    DeltaScenario result{MakeRandomNetwork(seed, 60, 16), {}, {}, {}, {}};
+    const auto& buses = result.network.buses;
+    result.base_buses.assign(buses.begin(), buses.end() - 4);
+    result.added_buses.assign(buses.end() - 4, buses.end());
+    result.removed_buses = {buses[1].name, buses[4].name};
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> factor(0.3, 2.0);
+    for (size_t bus : {0, 3, 6}) {
+        const std::pair hop{buses[bus].stops[1], buses[bus].stops[2]};
+        result.changed_distances[hop] = static_cast<int>(result.network.distances.at(hop) * factor(generator));
+    }
+    return result;
+}
+
+// Adds the buses and sets the distances of the scenario, the delta views into the scenario's names
+router::RouterDelta ChangeCatalogue(catalogue::TransportCatalogue& catalogue, const DeltaScenario& scenario) {
+    router::RouterDelta result;
+    for (const auto& bus : scenario.added_buses) {
+        AddBus(catalogue, bus);
+        result.added_buses.push_back(bus.name);
+    }
+    for (const auto& name : scenario.removed_buses) {
+        result.removed_buses.push_back(name);
+    }
+    for (const auto& [hop, distance] : scenario.changed_distances) {
+        catalogue.SetStopDistance(catalogue.FindStop(hop.first), catalogue.FindStop(hop.second), distance);
+        result.changed_distances.push_back(hop);
+    }
+    return result;
+}
+
+// The catalogue of the final state built from scratch, the removed buses are left out
+void FillChangedCatalogue(catalogue::TransportCatalogue& catalogue, const DeltaScenario& scenario) {
+    RandomNetwork network = scenario.network;
+    for (const auto& [hop, distance] : scenario.changed_distances) {
+        network.distances[hop] = distance;
+    }
+    std::vector<RandomBus> buses;
+    for (const auto& bus : network.buses) {
+        if (std::find(scenario.removed_buses.begin(), scenario.removed_buses.end(), bus.name) == scenario.removed_buses.end()) {
+            buses.push_back(bus);
+        }
+    }
+    FillCatalogue(catalogue, network, buses);
+}
+
+// The matrix of travel times between all stops is the same in both routers
+void CheckSameMatrix(const router::TransportRouter& changed, const router::TransportRouter& expected, const std::vector<std::string_view>& names) {
+    const auto matrix = changed.BuildMatrix(names, names);
+    const auto expected_matrix = expected.BuildMatrix(names, names);
+    for (size_t i = 0; i < names.size(); ++i) {
+        for (size_t j = 0; j < names.size(); ++j) {
+            CHECK(matrix[i][j].has_value() == expected_matrix[i][j].has_value());
+            CHECK(!matrix[i][j] || std::abs(*matrix[i][j] - *expected_matrix[i][j]) <= 1e-4);
+        }
+    }
+}
+
+std::vector<std::string_view> GetStopNames(const DeltaScenario& scenario) {
+    std::vector<std::string_view> names;
+    for (const auto& stop : scenario.network.stops) {
+        names.push_back(stop.first);
+    }
+    return names;
+}
+
+// Routes between all stops and the matrix of travel times are the same in both routers. The routes of the
+// changed router ride no removed or cancelled bus and neither board nor alight at a closed stop.
+void CheckSameRoutes(router::TransportRouter& changed, router::TransportRouter& expected, const catalogue::TransportCatalogue& catalogue,
+                     const DeltaScenario& scenario, const router::Disruptions* disruptions) {
+    std::vector<std::string_view> unused_buses(scenario.removed_buses.begin(), scenario.removed_buses.end());
+    std::vector<std::string_view> closed_stops;
+    if (disruptions != nullptr) {
+        unused_buses.insert(unused_buses.end(), disruptions->buses.begin(), disruptions->buses.end());
+        closed_stops = disruptions->stops;
+    }
+    const auto contains = [](const std::vector<std::string_view>& names, std::string_view name) {
+        return std::find(names.begin(), names.end(), name) != names.end();
+    };
+
+    const std::vector<std::string_view> names = GetStopNames(scenario);
+    for (auto from : names) {
+        for (auto to : names) {
+            const auto route = changed.BuildRoute(from, to);
+            const auto expected_route = expected.BuildRoute(from, to);
+            CHECK(route.has_value() == expected_route.has_value());
+            if (!route) {
+                continue;
+            }
+            CHECK(AreEqualTimes(SumWeights(changed, *route), SumWeights(expected, *expected_route)));
+
+            graph::VertexId vertex = 2 * static_cast<graph::VertexId>(catalogue.FindStop(from)->id);
+            for (graph::EdgeId edge_id : route->edges) {
+                const auto& edge = changed.GetEdge(edge_id);
+                CHECK(edge.from == vertex);
+                vertex = edge.to;
+                CHECK(edge.bus_name_id == domain::NO_NAME || !contains(unused_buses, changed.GetName(edge.bus_name_id)));
+                // Buses still pass closed stops, their route vertices stay open
+                for (graph::VertexId end : {edge.from, edge.to}) {
+                    CHECK(end >= 2 * names.size() || !contains(closed_stops, changed.GetVertexStop(end)->Stop_name));
+                }
+            }
+            CHECK(vertex == 2 * static_cast<graph::VertexId>(catalogue.FindStop(to)->id));
+        }
+    }
+    CheckSameMatrix(changed, expected, names);
+}
+
+// RAPTOR builds no graph: the journeys between all stops take as long and change as often, and ride no removed bus
+void CheckSameJourneys(const router::TransportRouter& changed, const router::TransportRouter& expected, const DeltaScenario& scenario) {
+    const std::vector<std::string_view> names = GetStopNames(scenario);
+    for (auto from : names) {
+        for (auto to : names) {
+            const auto journeys = changed.BuildJourneys(from, to);
+            const auto expected_journeys = expected.BuildJourneys(from, to);
+            CHECK(journeys.size() == expected_journeys.size());
+            for (size_t i = 0; i < journeys.size(); ++i) {
+                CHECK(AreEqualTimes(journeys[i].total_time, expected_journeys[i].total_time));
+                CHECK(journeys[i].GetTransferCount() == expected_journeys[i].GetTransferCount());
+                for (const auto& leg : journeys[i].legs) {
+                    CHECK(std::find(scenario.removed_buses.begin(), scenario.removed_buses.end(), leg.bus->bus_name) == scenario.removed_buses.end());
+                }
+            }
+        }
+    }
+    CheckSameMatrix(changed, expected, names);
+}
+
+void CheckSameRouter(router::TransportRouter& changed, router::TransportRouter& expected, const catalogue::TransportCatalogue& catalogue,
+                     const DeltaScenario& scenario) {
+    if (changed.GetRouterSettings().engine == router::RouterEngine::RAPTOR) {
+        CheckSameJourneys(changed, expected, scenario);
+    }
+    else {
+        CheckSameRoutes(changed, expected, catalogue, scenario, nullptr);
+    }
+}
+
+std::vector<router::RouterSettings> MakeDeltaSettings() {
+    std::vector<router::RouterSettings> result = MakeGraphSettings();
+    router::RouterSettings raptor;
+    raptor.bus_wait_time = 4;
+    raptor.bus_velocity = 30 * 1000.0 / 60;
+    raptor.engine = router::RouterEngine::RAPTOR;
+    result.push_back(raptor);
+    return result;
+}
+
+// A router changed by ApplyDelta answers as one built from scratch over the final catalogue
+void TestApplyDeltaMatchesRebuild() {
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        const DeltaScenario scenario = MakeDeltaScenario(seed);
+        catalogue::TransportCatalogue expected_catalogue;
+        FillChangedCatalogue(expected_catalogue, scenario);
+        for (const auto& settings : MakeDeltaSettings()) {
+            catalogue::TransportCatalogue catalogue;
+            FillCatalogue(catalogue, scenario.network, scenario.base_buses);
+            router::TransportRouter changed(settings, &catalogue);
+            changed.BuildRouter();
+            changed.ApplyDelta(ChangeCatalogue(catalogue, scenario));
+
+            router::TransportRouter expected(settings, &expected_catalogue);
+            expected.BuildRouter();
+            CheckSameRouter(changed, expected, catalogue, scenario);
+        }
+    }
+}
+
+// Builds the router and the catalogue again from their serialized base, as process_requests does
+struct LoadedRouter {
+    transport_catalogue_serialize::DataBase database;
+    std::unique_ptr<catalogue::TransportCatalogue> catalogue;
+    std::unique_ptr<router::TransportRouter> router;
+};
+
+std::unique_ptr<LoadedRouter> SerializeAndLoad(const catalogue::TransportCatalogue& catalogue, const router::TransportRouter& transport_router) {
+    auto result = std::make_unique<LoadedRouter>();
+    IndexBook book;
+    SerializeTransportCatalogue(catalogue, result->database, book);
+    SerializeTransportRouter(transport_router, result->database, book);
+    result->catalogue = std::make_unique<catalogue::TransportCatalogue>(*result->database.mutable_catalogue_base());
+    result->router = std::make_unique<router::TransportRouter>(result->database.transport_router_base(), *result->catalogue);
+    return result;
+}
+
+// The delta is kept in the base, and a base that holds one takes another: half of the scenario is applied
+// before the router is stored and the rest after it is loaded
+void TestDeltaSurvivesBase() {
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        const DeltaScenario scenario = MakeDeltaScenario(seed);
+        catalogue::TransportCatalogue expected_catalogue;
+        FillChangedCatalogue(expected_catalogue, scenario);
+        for (const auto& settings : MakeDeltaSettings()) {
+            DeltaScenario first = scenario;
+            first.added_buses.resize(scenario.added_buses.size() / 2);
+            first.removed_buses.resize(1);
+            first.changed_distances.erase(std::next(first.changed_distances.begin()), first.changed_distances.end());
+            DeltaScenario second = scenario;
+            second.added_buses.erase(second.added_buses.begin(), second.added_buses.begin() + first.added_buses.size());
+            second.removed_buses.erase(second.removed_buses.begin());
+            second.changed_distances.erase(second.changed_distances.begin());
+
+            catalogue::TransportCatalogue catalogue;
+            FillCatalogue(catalogue, scenario.network, scenario.base_buses);
+            router::TransportRouter changed(settings, &catalogue);
+            changed.BuildRouter();
+            changed.ApplyDelta(ChangeCatalogue(catalogue, first));
+
+            router::TransportRouter expected(settings, &expected_catalogue);
+            expected.BuildRouter();
+
+            auto loaded = SerializeAndLoad(catalogue, changed);
+            CHECK(loaded->router->HasDelta());
+            loaded->router->ApplyDelta(ChangeCatalogue(*loaded->catalogue, second));
+            CheckSameRouter(*loaded->router, expected, *loaded->catalogue, scenario);
+
+            auto reloaded = SerializeAndLoad(*loaded->catalogue, *loaded->router);
+            CheckSameRouter(*reloaded->router, expected, *reloaded->catalogue, scenario);
+        }
+    }
+}
+
+// Disruptions set before ApplyDelta close the edges it appends as well: a new bus through a closed stop
+// and a cancelled bus whose edges are built again after a distance change
+void TestApplyDeltaKeepsDisruptions() {
+    for (uint32_t seed = 0; seed < SEED_COUNT; ++seed) {
+        const DeltaScenario scenario = MakeDeltaScenario(seed);
+        router::Disruptions disruptions;
+        disruptions.stops = {scenario.added_buses[0].stops[1], scenario.added_buses[1].stops[2]};
+        disruptions.buses = {scenario.network.buses[0].name, scenario.network.buses[3].name};
+
+        catalogue::TransportCatalogue expected_catalogue;
+        FillChangedCatalogue(expected_catalogue, scenario);
+        for (const auto& settings : MakeGraphSettings()) {
+            catalogue::TransportCatalogue catalogue;
+            FillCatalogue(catalogue, scenario.network, scenario.base_buses);
+            router::TransportRouter changed(settings, &catalogue);
+            changed.BuildRouter();
+            changed.SetDisruptions(disruptions);
+            changed.ApplyDelta(ChangeCatalogue(catalogue, scenario));
+
+            router::TransportRouter expected(settings, &expected_catalogue);
+            expected.BuildRouter();
+            expected.SetDisruptions(disruptions);
+            CheckSameRoutes(changed, expected, catalogue, scenario, &disruptions);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestPointRoutesMatchBruteForce);
+    RUN_TEST(TestPointRoutesNeedGraphEngine);
+    RUN_TEST(TestApplyDeltaKeepsDisruptions);
+    RUN_TEST(TestApplyDeltaMatchesRebuild);
+    RUN_TEST(TestDeltaSurvivesBase);
+}
@@ -1,168 +1,329 @@
-#include "transport_catalogue.h"
-//using namespace catalogue;
-using namespace catalogue::detail;
-using namespace geo;
-using namespace domain;
-namespace catalogue {
-
-	TransportCatalogue::TransportCatalogue(transport_catalogue_serialize::TransportCatalogue& db) {
-		InsertStops(db);
-		InsertBuses(db);
-		InsertStopToBuses(db);
-		InsertDistances(db);
-	}
-
-	void TransportCatalogue::AddStop(std::string stop_name, Coordinates coords) {
-		bus_stops_.push_back({ std::move(stop_name),std::move(coords) });
-		view_to_stop_.insert({ bus_stops_.back().Stop_name, &bus_stops_.back() });
-		stop_ptrs_.push_back(&bus_stops_.back());
-	}
-	void TransportCatalogue::AddBusRoute(std::string bus_name, std::vector<std::string_view> stops, bool is_roundtrip) {
-
-		Bus temp_bus;
-		temp_bus.bus_name = std::move(bus_name);
-		temp_bus.is_roundtrip = is_roundtrip;
-		for (size_t i = 0; i < stops.size(); i++)
-		{
-			const Stop* temp_stop = FindStop(stops[i]);
-			temp_bus.route.push_back(temp_stop);
-			temp_bus.unique_stops.insert(temp_stop);
-		}
-
-		buses_.push_back(std::move(temp_bus));
-		bus_ptrs_.push_back(&buses_.back());
-		view_to_bus_.insert({ buses_.back().bus_name, &buses_.back() });
-
-
-		for (const Stop* stop : buses_.back().unique_stops)
-		{
-			stop_to_buses_[stop].insert(buses_.back().bus_name);
-		}
-	}
-
-	const Stop* TransportCatalogue::FindStop(std::string_view stop_name) const {
-		auto ptr = view_to_stop_.find(stop_name);
-		if (ptr != view_to_stop_.end())
-		{
-			return ptr->second;
-		}
-		return nullptr;
-	}
-
-	const Bus* TransportCatalogue::FindBusRoute(std::string_view bus_name) const {
-		auto ptr = view_to_bus_.find(bus_name);
-		if (ptr != view_to_bus_.end())
-		{
-			return ptr->second;
-		}
-		return nullptr;
-	}
-
-	RouteStats TransportCatalogue::ComputeRouteStats(const Bus* temp_bus) const {
-
-		RouteStats temp_stats;
-
-		for (size_t i = 0; i < temp_bus->route.size() - 1; i++)
-		{
-			temp_stats.route_length += GetStopDistance(temp_bus->route[i], temp_bus->route[i + 1]);
-			temp_stats.curvature += ComputeDistance(temp_bus->route[i]->coordinates, temp_bus->route[i + 1]->coordinates);
-		}
-
-		temp_stats.curvature = temp_stats.route_length / temp_stats.curvature;
-
-		return temp_stats;
-	}
-
-	RouteInfo TransportCatalogue::GetRouteInfo(const Bus* bus) const {
-		return { bus ,ComputeRouteStats(bus) };
-	}
-
-	StopInfo TransportCatalogue::GetStopInfo(const Stop* stop) const {
-		if (stop_to_buses_.count(stop))
-		{
-			return { stop,{stop_to_buses_.at(stop).begin(),stop_to_buses_.at(stop).end()} };
-		}
-		return { stop,{} };
-	}
-
-	void TransportCatalogue::SetStopDistance(const Stop* from, const Stop* to, int distance) {
-		stop_distance_[{from, to}] = distance;
-	}
-
-	int TransportCatalogue::GetStopDistance(const Stop* from, const Stop* to) const {
-		if (stop_distance_.count({ from,to }))
-		{
-			return stop_distance_.at({ from,to });
-		}
-		else if (stop_distance_.count({ to,from })) {
-			return stop_distance_.at({ to,from });
-		}
-		return 0;
-	}
-
-	const std::vector<const domain::Bus*>& TransportCatalogue::GetRoutes() const{
-		return bus_ptrs_;
-		
-	}
-	const std::vector<const domain::Stop*>& TransportCatalogue::GetStops() const {
-		return stop_ptrs_;
-	}
-
-	const std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, int, catalogue::detail::StopPairHasher>& TransportCatalogue::GetStopDistances() const {
-		return stop_distance_;
-	}
-
-	const std::unordered_map<const domain::Stop*, std::unordered_set <std::string_view>>& TransportCatalogue::GetStopToBuses() const{
-		return stop_to_buses_;
-	}
-
-//private:
-
-void TransportCatalogue::InsertBuses(transport_catalogue_serialize::TransportCatalogue& db) {
-	buses_.resize(db.index_to_bus().size());
-	bus_ptrs_.resize(db.index_to_bus().size());
-	for (auto& [index, bus] : db.index_to_bus()) {
-		Bus temp_bus;
-		temp_bus.bus_name = std::string{ bus.bus_name() };
-		temp_bus.is_roundtrip = bus.is_roundtrip();
-		temp_bus.curvature = bus.curvature();
-		temp_bus.route_length = bus.route_length();
-
-		for (auto stop : bus.stops()) {
-			temp_bus.route.push_back(&bus_stops_[stop]);
-			temp_bus.unique_stops.insert(&bus_stops_[stop]);
-		}
-
-		buses_[index] = std::move(temp_bus);
-		bus_ptrs_[index] = &buses_[index];
-		view_to_bus_.insert({ buses_[index].bus_name, &buses_[index] });
-	}
-}
-void TransportCatalogue::InsertStops(transport_catalogue_serialize::TransportCatalogue& db) {
-	bus_stops_.resize(db.index_to_stop().size());
-	stop_ptrs_.resize(db.index_to_stop().size());
-	for (auto& [index, stop] : db.index_to_stop()) {
-		Stop temp_stop;
-		temp_stop.coordinates = { stop.coords().lat(),stop.coords().lng() };
-		temp_stop.Stop_name = std::string{ stop.stop_name() };
-		bus_stops_[index] = std::move(temp_stop);
-
-		view_to_stop_.insert({ bus_stops_[index].Stop_name, &bus_stops_[index] });
-		stop_ptrs_[index] = &bus_stops_[index];
-	}
-}
-void TransportCatalogue::InsertStopToBuses(transport_catalogue_serialize::TransportCatalogue& db) {
-	for (auto [stop, buses] : db.stop_to_buses()) {
-		stop_to_buses_[&bus_stops_[stop]];
-		for (auto bus : buses.buses()) {
-			stop_to_buses_[&bus_stops_[stop]].insert(buses_[bus].bus_name);
-		}
-	}
-}
-void TransportCatalogue::InsertDistances(transport_catalogue_serialize::TransportCatalogue& db) {
-	for (auto distance : db.distances()) {
-		stop_distance_[{&bus_stops_[distance.from()], & bus_stops_[distance.to()]}] = distance.distance();
-	}
-}
-
+#include "transport_catalogue.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+//using namespace catalogue;
+using namespace catalogue::detail;
+using namespace geo;
+using namespace domain;
+namespace catalogue {
+
+	TransportCatalogue::TransportCatalogue(transport_catalogue_serialize::TransportCatalogue& db) {
+		InsertStops(db);
+		BuildStopIndex();
+		InsertBuses(db);
+		InsertStopToBuses(db);
+		InsertDistances(db);
+	}
+
+	void TransportCatalogue::SetCompactCoordinates(bool compact) {
+		if (!bus_stops_.empty()) {
+			throw std::logic_error("Coordinates' encoding is set before stops are added");
+		}
+		stop_coordinates_ = geo::CoordinateArray(compact);
+	}
+
+	bool TransportCatalogue::HasCompactCoordinates() const {
+		return stop_coordinates_.IsCompact();
+	}
+
+	void TransportCatalogue::AddStop(std::string_view stop_name, Coordinates coords) {
+		const NameId id = names_.Intern(stop_name);
+		bus_stops_.push_back({ names_.GetName(id),id,static_cast<uint32_t>(stop_ptrs_.size()) });
+		stop_ptrs_.push_back(&bus_stops_.back());
+		stop_coordinates_.Add(coords);
+		// Everything derived from the stop sees the coordinates as they are stored
+		stop_vectors_.Add(stop_coordinates_.Get(bus_stops_.back().id));
+		road_distances_.emplace_back();
+		stop_buses_.emplace_back();
+		if (name_to_stop_.size() <= id) {
+			name_to_stop_.resize(id + 1, nullptr);
+		}
+		name_to_stop_[id] = &bus_stops_.back();
+	}
+	void TransportCatalogue::AddBusRoute(std::string_view bus_name, std::vector<std::string_view> stops, bool is_roundtrip) {
+
+		Bus temp_bus;
+		temp_bus.name_id = names_.Intern(bus_name);
+		temp_bus.bus_name = names_.GetName(temp_bus.name_id);
+		temp_bus.is_roundtrip = is_roundtrip;
+		temp_bus.id = static_cast<uint32_t>(bus_ptrs_.size());
+		for (size_t i = 0; i < stops.size(); i++)
+		{
+			const Stop* temp_stop = FindStop(stops[i]);
+			temp_bus.route.push_back(temp_stop);
+			temp_bus.unique_stops.insert(temp_stop);
+		}
+
+		UpdateRouteStats(temp_bus);
+		buses_.push_back(std::move(temp_bus));
+		bus_ptrs_.push_back(&buses_.back());
+		if (name_to_bus_.size() <= buses_.back().name_id) {
+			name_to_bus_.resize(buses_.back().name_id + 1, nullptr);
+		}
+		name_to_bus_[buses_.back().name_id] = &buses_.back();
+
+
+		const Bus* bus = &buses_.back();
+		for (const Stop* stop : bus->unique_stops)
+		{
+			auto& buses = stop_buses_[stop->id];
+			buses.insert(std::upper_bound(buses.begin(), buses.end(), bus, [](const Bus* lhs, const Bus* rhs) {
+				return lhs->bus_name < rhs->bus_name;
+			}), bus);
+		}
+	}
+
+	const Stop* TransportCatalogue::FindStop(std::string_view stop_name) const {
+		const NameId id = names_.Find(stop_name);
+		if (id < name_to_stop_.size())
+		{
+			return name_to_stop_[id];
+		}
+		return nullptr;
+	}
+
+	const Bus* TransportCatalogue::FindBusRoute(std::string_view bus_name) const {
+		const NameId id = names_.Find(bus_name);
+		if (id < name_to_bus_.size())
+		{
+			return name_to_bus_[id];
+		}
+		return nullptr;
+	}
+
+	RouteStats TransportCatalogue::ComputeRouteStats(const Bus* temp_bus) const {
+
+		RouteStats temp_stats;
+
+		const std::vector<int> segments = GetRouteSegmentDistances(temp_bus);
+		std::vector<uint32_t> stop_ids;
+		stop_ids.reserve(temp_bus->route.size());
+		for (const Stop* stop : temp_bus->route) {
+			stop_ids.push_back(stop->id);
+		}
+		const std::vector<double> geo_segments = stop_vectors_.ComputeDistances(stop_ids.data(), stop_ids.data() + 1, segments.size());
+		for (size_t i = 0; i < segments.size(); i++)
+		{
+			temp_stats.route_length += segments[i];
+			temp_stats.curvature += geo_segments[i];
+		}
+
+		temp_stats.curvature = temp_stats.route_length / temp_stats.curvature;
+		temp_stats.stop_count = static_cast<int>(temp_bus->route.size());
+		temp_stats.unique_stop_count = static_cast<int>(temp_bus->unique_stops.size());
+
+		return temp_stats;
+	}
+
+	void TransportCatalogue::UpdateRouteStats(Bus& bus) const {
+		const RouteStats stats = ComputeRouteStats(&bus);
+		bus.route_length = stats.route_length;
+		bus.curvature = stats.curvature;
+		bus.stop_count = stats.stop_count;
+		bus.unique_stop_count = stats.unique_stop_count;
+	}
+
+	void TransportCatalogue::UpdateRouteStats(const Stop* stop) {
+		for (const Bus* bus : stop_buses_[stop->id]) {
+			UpdateRouteStats(buses_[bus->id]);
+		}
+	}
+
+	RouteInfo TransportCatalogue::GetRouteInfo(const Bus* bus) const {
+		return { bus ,{ bus->route_length,bus->curvature,bus->stop_count,bus->unique_stop_count } };
+	}
+
+	StopInfo TransportCatalogue::GetStopInfo(const Stop* stop) const {
+		return { stop,stop_buses_[stop->id] };
+	}
+
+	void TransportCatalogue::SetStopDistance(const Stop* from, const Stop* to, int distance) {
+		StoreStopDistance(from->id, to->id, distance);
+		// A bus through both stops is recomputed twice, distances rarely change once buses are added
+		UpdateRouteStats(from);
+		UpdateRouteStats(to);
+	}
+
+	void TransportCatalogue::StoreStopDistance(uint32_t from, uint32_t to, int distance) {
+		auto& distances = road_distances_[from];
+		auto it = std::lower_bound(distances.begin(), distances.end(), to, [](const RoadDistance& lhs, uint32_t id) {
+			return lhs.to < id;
+		});
+		if (it != distances.end() && it->to == to) {
+			it->distance = distance;
+		}
+		else {
+			distances.insert(it, { to,distance });
+		}
+	}
+
+	const int* TransportCatalogue::FindStopDistance(uint32_t from, uint32_t to) const {
+		// A stop has few neighbours, a linear scan of the sorted list beats a binary search
+		for (const auto& road : road_distances_[from]) {
+			if (road.to >= to) {
+				return road.to == to ? &road.distance : nullptr;
+			}
+		}
+		return nullptr;
+	}
+
+	int TransportCatalogue::GetStopDistance(const Stop* from, const Stop* to) const {
+		if (const int* distance = FindStopDistance(from->id, to->id))
+		{
+			return *distance;
+		}
+		else if (const int* distance = FindStopDistance(to->id, from->id)) {
+			return *distance;
+		}
+		return 0;
+	}
+
+	std::vector<int> TransportCatalogue::GetRouteSegmentDistances(const Bus* bus) const {
+		std::vector<int> result;
+		if (bus->route.empty()) {
+			return result;
+		}
+		result.reserve(bus->route.size() - 1);
+		for (size_t i = 1; i < bus->route.size(); i++) {
+			result.push_back(GetStopDistance(bus->route[i - 1], bus->route[i]));
+		}
+		return result;
+	}
+
+	const std::vector<const domain::Bus*>& TransportCatalogue::GetRoutes() const{
+		return bus_ptrs_;
+		
+	}
+	const std::vector<const domain::Stop*>& TransportCatalogue::GetStops() const {
+		return stop_ptrs_;
+	}
+
+	const std::vector<RoadDistance>& TransportCatalogue::GetStopDistances(const Stop* from) const {
+		return road_distances_[from->id];
+	}
+
+	const std::vector<const Bus*>& TransportCatalogue::GetStopBuses(const Stop* stop) const {
+		return stop_buses_[stop->id];
+	}
+
+	const NameArena& TransportCatalogue::GetNames() const {
+		return names_;
+	}
+
+	const geo::CoordinateArray& TransportCatalogue::GetStopCoordinates() const {
+		return stop_coordinates_;
+	}
+
+	Coordinates TransportCatalogue::GetCoordinates(const Stop* stop) const {
+		return stop_coordinates_.Get(stop->id);
+	}
+
+	void TransportCatalogue::BuildStopIndex() {
+		stop_index_ = geo::SpatialIndex(stop_coordinates_);
+	}
+
+	std::vector<std::pair<const Stop*, double>> TransportCatalogue::FindNearestStops(Coordinates point, size_t count) const {
+		std::vector<std::pair<const Stop*, double>> result;
+		for (auto [id, distance] : stop_index_.FindNearest(point, count)) {
+			result.emplace_back(stop_ptrs_[id], distance);
+		}
+		return result;
+	}
+
+	std::vector<std::pair<const Stop*, double>> TransportCatalogue::FindStopsWithinRadius(Coordinates point, double radius) const {
+		std::vector<std::pair<const Stop*, double>> result;
+		for (auto [id, distance] : stop_index_.FindWithinRadius(point, radius)) {
+			result.emplace_back(stop_ptrs_[id], distance);
+		}
+		return result;
+	}
+
+	std::vector<const Stop*> TransportCatalogue::FindStopsInBox(Coordinates min, Coordinates max) const {
+		std::vector<const Stop*> result;
+		for (auto id : stop_index_.FindInBox(min, max)) {
+			result.push_back(stop_ptrs_[id]);
+		}
+		return result;
+	}
+
+//private:
+
+void TransportCatalogue::InsertBuses(transport_catalogue_serialize::TransportCatalogue& db) {
+	buses_.resize(db.index_to_bus().size());
+	bus_ptrs_.resize(db.index_to_bus().size());
+	for (auto& [index, bus] : db.index_to_bus()) {
+		Bus temp_bus;
+		temp_bus.name_id = names_.Intern(bus.bus_name());
+		temp_bus.bus_name = names_.GetName(temp_bus.name_id);
+		temp_bus.is_roundtrip = bus.is_roundtrip();
+		temp_bus.curvature = bus.curvature();
+		temp_bus.route_length = bus.route_length();
+		temp_bus.stop_count = bus.stop_count();
+		temp_bus.unique_stop_count = bus.unique_stop_count();
+		temp_bus.id = index;
+
+		for (auto stop : bus.stops()) {
+			temp_bus.route.push_back(&bus_stops_[stop]);
+			temp_bus.unique_stops.insert(&bus_stops_[stop]);
+		}
+
+		buses_[index] = std::move(temp_bus);
+		bus_ptrs_[index] = &buses_[index];
+	}
+	name_to_bus_.assign(names_.GetSize(), nullptr);
+	for (auto& bus : buses_) {
+		name_to_bus_[bus.name_id] = &bus;
+	}
+}
+void TransportCatalogue::InsertStops(transport_catalogue_serialize::TransportCatalogue& db) {
+	bus_stops_.resize(db.index_to_stop().size());
+	stop_ptrs_.resize(db.index_to_stop().size());
+	for (auto& [index, stop] : db.index_to_stop()) {
+		Stop temp_stop;
+		temp_stop.name_id = names_.Intern(stop.stop_name());
+		temp_stop.Stop_name = names_.GetName(temp_stop.name_id);
+		temp_stop.id = index;
+		bus_stops_[index] = std::move(temp_stop);
+		stop_ptrs_[index] = &bus_stops_[index];
+	}
+	name_to_stop_.assign(names_.GetSize(), nullptr);
+	road_distances_.resize(bus_stops_.size());
+	stop_buses_.resize(bus_stops_.size());
+	for (auto& stop : bus_stops_) {
+		name_to_stop_[stop.name_id] = &stop;
+	}
+
+	// The map is keyed by id, the coordinates are added in id order
+	stop_coordinates_ = geo::CoordinateArray(db.compact_coordinates());
+	stop_coordinates_.Reserve(bus_stops_.size());
+	stop_vectors_.Reserve(bus_stops_.size());
+	for (uint32_t id = 0; id < bus_stops_.size(); id++) {
+		const auto& stop = db.index_to_stop().at(static_cast<int>(id));
+		if (db.compact_coordinates()) {
+			stop_coordinates_.Add(geo::CompactCoordinates{ stop.compact_coords().lat(),stop.compact_coords().lng() });
+		}
+		else {
+			stop_coordinates_.Add(Coordinates{ stop.coords().lat(),stop.coords().lng() });
+		}
+		stop_vectors_.Add(stop_coordinates_.Get(id));
+	}
+}
+void TransportCatalogue::InsertStopToBuses(transport_catalogue_serialize::TransportCatalogue& db) {
+	// Stored already sorted by bus name
+	for (auto& [stop, buses] : db.stop_to_buses()) {
+		auto& stop_buses = stop_buses_[stop];
+		stop_buses.reserve(buses.buses_size());
+		for (auto bus : buses.buses()) {
+			stop_buses.push_back(&buses_[bus]);
+		}
+	}
+}
+void TransportCatalogue::InsertDistances(transport_catalogue_serialize::TransportCatalogue& db) {
+	for (auto distance : db.distances()) {
+		StoreStopDistance(distance.from(), distance.to(), distance.distance());
+	}
+}
+
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <deque>
 #include <set>
 #include <string>
@@ -10,6 +11,7 @@
 
 #include "domain.h"
 #include "geo.h"
+#include "spatial_index.h"
 #include <transport_catalogue.pb.h>
 namespace catalogue {
 
@@ -18,6 +20,8 @@ namespace catalogue {
 		struct RouteStats {
 			double route_length = 0;
 			double curvature = 0.0;
+			int stop_count = 0;
+			int unique_stop_count = 0;
 		};
 
 		struct RouteInfo
@@ -28,15 +32,14 @@ namespace catalogue {
 
 		struct StopInfo {
 			const domain::Stop* stop;
-			std::set<std::string_view> buses{};
+			// Sorted by bus name
+			const std::vector<const domain::Bus*>& buses;
 		};
 
-		struct StopPairHasher {
-			const int NUMBER = 31;
-			size_t operator() (std::pair<const domain::Stop*, const domain::Stop*> pair) const {
-				return ptr_hasher(pair.first) * NUMBER + ptr_hasher(pair.second) * (NUMBER * NUMBER);
-			}
-			std::hash<const void*> ptr_hasher;
+		// Road length from a stop to the stop with id to
+		struct RoadDistance {
+			uint32_t to;
+			int distance;
 		};
 	}
 
@@ -46,21 +49,47 @@ namespace catalogue {
 		TransportCatalogue() = default;
 		TransportCatalogue(transport_catalogue_serialize::TransportCatalogue& db);
 
-		void AddStop(std::string stop, geo::Coordinates coords);
-		void AddBusRoute(std::string bus, std::vector<std::string_view> stops, bool);
+		// Stops added afterwards are rounded to whole microdegrees and their coordinates are kept
+		// and serialized as geo::CompactCoordinates; only before the first stop is added.
+		// Nothing else stores the coordinates, the router and the renderer decode them from here
+		void SetCompactCoordinates(bool compact);
+		bool HasCompactCoordinates() const;
+
+		void AddStop(std::string_view stop, geo::Coordinates coords);
+		void AddBusRoute(std::string_view bus, std::vector<std::string_view> stops, bool);
 		void SetStopDistance(const domain::Stop* from, const domain::Stop* to, int diststance);
 
 		const domain::Stop* FindStop(std::string_view stop_name) const;
 		const domain::Bus* FindBusRoute(std::string_view bus_name) const;
 
+		// Stats stored in the bus, nothing is computed
 		catalogue::detail::RouteInfo GetRouteInfo(const domain::Bus* bus) const;
 		catalogue::detail::StopInfo GetStopInfo(const domain::Stop* stop) const;
 		const std::vector<const domain::Bus*>& GetRoutes() const;
 		const std::vector<const domain::Stop*>& GetStops() const;
-		const std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, int, catalogue::detail::StopPairHasher>& GetStopDistances() const;
-		const std::unordered_map<const domain::Stop*, std::unordered_set <std::string_view>>& GetStopToBuses() const;
+		// Distances set from the stop, ordered by the id of the other stop
+		const std::vector<catalogue::detail::RoadDistance>& GetStopDistances(const domain::Stop* from) const;
+		// Buses through the stop, sorted by name and without repeats
+		const std::vector<const domain::Bus*>& GetStopBuses(const domain::Stop* stop) const;
+		// The distance set from one stop to the other, otherwise the one set backwards, otherwise 0
 		int GetStopDistance(const domain::Stop* from, const domain::Stop* to) const;
+		// Road lengths between consecutive stops of the route
+		std::vector<int> GetRouteSegmentDistances(const domain::Bus* bus) const;
 		catalogue::detail::RouteStats ComputeRouteStats(const domain::Bus* temp_bus) const;
+		// Names of stops and buses, their ids are the name_id of Stop and Bus
+		const domain::NameArena& GetNames() const;
+		// Coordinates of the stop with id i, kept apart for kernels over all stops
+		const geo::CoordinateArray& GetStopCoordinates() const;
+		geo::Coordinates GetCoordinates(const domain::Stop* stop) const;
+
+		// Indexes the coordinates of all stops added so far for the two searches below
+		void BuildStopIndex();
+		// Up to count stops closest to the point with their distances in meters, closest first
+		std::vector<std::pair<const domain::Stop*, double>> FindNearestStops(geo::Coordinates point, size_t count) const;
+		// Stops within radius meters of the point with their distances, ordered by id
+		std::vector<std::pair<const domain::Stop*, double>> FindStopsWithinRadius(geo::Coordinates point, double radius) const;
+		// Stops inside the box given by its south-west and north-east corners, ordered by id
+		std::vector<const domain::Stop*> FindStopsInBox(geo::Coordinates min, geo::Coordinates max) const;
 	private:
 		std::deque<domain::Stop> bus_stops_;
 		std::deque<domain::Bus> buses_;
@@ -68,15 +97,31 @@ namespace catalogue {
 		std::vector<const domain::Bus*> bus_ptrs_;
 		std::vector<const domain::Stop*> stop_ptrs_;
 
-		std::unordered_map<const domain::Stop*, std::unordered_set <std::string_view>> stop_to_buses_;
-		std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, int, catalogue::detail::StopPairHasher> stop_distance_;
+		// Indexed by stop id, kept sorted as buses are added
+		std::vector<std::vector<const domain::Bus*>> stop_buses_;
+		// Indexed by stop id, each list sorted by RoadDistance::to
+		std::vector<std::vector<catalogue::detail::RoadDistance>> road_distances_;
+
+		domain::NameArena names_;
+		// Indexed by name id, nullptr where the name belongs to no stop or no bus
+		std::vector<const domain::Stop*> name_to_stop_;
+		std::vector<const domain::Bus*> name_to_bus_;
 
-		std::unordered_map<std::string_view, const domain::Stop*> view_to_stop_;
-		std::unordered_map<std::string_view, const domain::Bus*> view_to_bus_;
+		geo::CoordinateArray stop_coordinates_;
+		// Indexed by stop id, road segments' great-circle lengths are computed from them in one batch per route
+		geo::UnitVectors stop_vectors_;
+		geo::SpatialIndex stop_index_;
 
 		void InsertBuses(transport_catalogue_serialize::TransportCatalogue& db);
 		void InsertStops(transport_catalogue_serialize::TransportCatalogue& db);
 		void InsertStopToBuses(transport_catalogue_serialize::TransportCatalogue& db);
 		void InsertDistances(transport_catalogue_serialize::TransportCatalogue& db);
+		// Sets the distance without touching the stats of the routes
+		void StoreStopDistance(uint32_t from, uint32_t to, int distance);
+		// Recomputes the stored stats of every bus through the stop
+		void UpdateRouteStats(const domain::Stop* stop);
+		void UpdateRouteStats(domain::Bus& bus) const;
+		// nullptr when no distance is set from one stop to the other
+		const int* FindStopDistance(uint32_t from, uint32_t to) const;
 	};
 }
\ No newline at end of file
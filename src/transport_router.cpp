@@ -1,131 +1,814 @@
-#include "transport_router.h"
-
-using namespace std::literals;
-
-router::TransportRouter::TransportRouter(const transport_router_serialize::TransportRouterDataBase& db, catalogue::TransportCatalogue& catalogue) {
-	catalogue_ = &catalogue;
-	InsertSettings(db);
-	InsertIdsAndStops(db);
-	InsertGraph(db, catalogue);
-	InsertRouter(db);
-}
-
-void router::TransportRouter::AddRoute(const domain::Bus* bus) {
-	for (size_t i = 0; i < bus->route.size(); i++) {
-		for (size_t c = i; c < bus->route.size(); c++) {
-			double distance = 0;
-			int span_count = 0;
-
-			if (i == c) {
-				continue;
-			}
-
-			for (size_t b = i; b < bus->route.size(); b++) {
-				if (bus->route[c] == bus->route[b]) {
-					break;
-				}
-
-				distance += catalogue_->GetStopDistance(bus->route[b], bus->route[b+1]);
-				span_count++;
-			}
-
-			graph_->AddEdge({ stop_to_id_.at(bus->route[i]),stop_to_id_.at(bus->route[c])-1,(distance / settings_.bus_velocity) / SECONDS_IN_MINUTE,bus->bus_name,span_count });
-
-		}
-
-	}
-}
-void router::TransportRouter::BuildRouter() {
-	graph_ = std::make_unique<graph::DirectedWeightedGraph<double>>(graph::DirectedWeightedGraph<double>(catalogue_->GetStops().size() * 2));
-	size_t id = 1;
-
-	for (const auto& stop : catalogue_->GetStops()) {
-		id_to_stop_.emplace(id, stop);
-		stop_to_id_.emplace(stop, id);
-
-		id++;
-		id++;
-	}
-
-	for (auto stop : catalogue_->GetStops()) {
-		graph_->AddEdge({ stop_to_id_.at(stop) - 1,stop_to_id_.at(stop),static_cast<double>(settings_.bus_wait_time) });
-	}
-
-	for (auto& bus : catalogue_->GetRoutes()) {
-		AddRoute(bus);
-	}
-
-	router_ = std::make_unique<graph::Router<double>>(graph::Router<double>(*graph_));
-}
-
-std::optional<graph::Router<double>::RouteInfo> router::TransportRouter::BuildRoute(std::string_view from, std::string_view to) {
-	return router_->BuildRoute(stop_to_id_.at(catalogue_->FindStop(from)) - 1, stop_to_id_.at(catalogue_->FindStop(to)) - 1);
-}
-
-const graph::Edge<double>& router::TransportRouter::GetEdge(graph::EdgeId id) const {
-	return graph_->GetEdge(id);
-}
-const std::map<graph::VertexId, const domain::Stop*>& router::TransportRouter::GetIdsToStops() const {
-	return id_to_stop_;
-}
-
-const graph::DirectedWeightedGraph<double>& router::TransportRouter::GetGraph() const {
-	return *graph_;
-}
-
-const graph::Router<double>& router::TransportRouter::GetRouter() const {
-	return *router_;
-}
-
-const router::RouterSettings& router::TransportRouter::GetRouterSettings() const {
-	return settings_;
-}
-
-void router::TransportRouter::InsertSettings(const transport_router_serialize::TransportRouterDataBase& db) {
-	settings_.bus_velocity = db.settings().bus_velocity();
-	settings_.bus_wait_time = db.settings().bus_wait_time();
-}
-
-void router::TransportRouter::InsertIdsAndStops(const transport_router_serialize::TransportRouterDataBase& db) {
-	size_t id = 1;
-	for (const auto& stop : catalogue_->GetStops()) {
-		id_to_stop_.emplace(id, stop);
-		stop_to_id_.emplace(stop, id);
-
-		id++;
-		id++;
-	}
-}
-
-void router::TransportRouter::InsertGraph(const transport_router_serialize::TransportRouterDataBase& db, catalogue::TransportCatalogue& catalogue) {
-	std::vector<std::vector<size_t>> incidence_lists;
-	for (auto& list : db.graph().incidence_lists_()) {
-		std::vector<size_t> temp_data;
-		for (auto data : list.list()) {
-			temp_data.push_back(data);
-		}
-		incidence_lists.push_back(temp_data);
-	}
-
-	std::vector<graph::Edge<double>> edges;
-	for (auto& edge : db.graph().edges_()) {
-		graph::Edge<double> temp_edge;
-
-		temp_edge.from = edge.from();
-		temp_edge.to = edge.to();
-		temp_edge.weight = edge.weight();
-		if (edge.bus_name_case() == 5) {
-			temp_edge.bus_name = catalogue.GetRoutes()[edge.data()]->bus_name;
-		}
-
-		temp_edge.span_count = edge.span_count();
-
-		edges.push_back(temp_edge);
-	}
-
-	graph_ = std::make_unique<graph::DirectedWeightedGraph<double>>(graph::DirectedWeightedGraph<double>(std::move(edges), std::move(incidence_lists)));
-}
-
-void router::TransportRouter::InsertRouter(const transport_router_serialize::TransportRouterDataBase& db) {
-	router_ = std::make_unique<graph::Router<double>>(graph::Router<double>(db.router(), *graph_));
-}
+#include "transport_router.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <unordered_set>
+
+using namespace std::literals;
+
+router::TransportRouter::TransportRouter(const transport_router_serialize::TransportRouterDataBase& db, catalogue::TransportCatalogue& catalogue) {
+	catalogue_ = &catalogue;
+	InsertSettings(db);
+	InsertIdsAndStops(db);
+	InsertRemovedBuses(db);
+	InsertGraph(db, catalogue);
+	InsertRouter(db);
+}
+
+void router::TransportRouter::AddRoute(const domain::Bus* bus, std::vector<graph::Edge<double>>& edges, EdgeIndex& edge_index) {
+	const auto& route = bus->route;
+
+	std::vector<graph::VertexId> ids;
+	ids.reserve(route.size());
+	for (auto stop : route) {
+		ids.push_back(GetBoardVertex(stop));
+	}
+
+	// distance_from_start[i] is the road length from the first stop of the route to its i-th stop
+	const std::vector<int> segments = catalogue_->GetRouteSegmentDistances(bus);
+	std::vector<double> distance_from_start(route.size(), 0);
+	for (size_t i = 1; i < route.size(); i++) {
+		distance_from_start[i] = distance_from_start[i - 1] + segments[i - 1];
+	}
+
+	for (size_t i = 0; i < route.size(); i++) {
+		for (size_t c = i + 1; c < route.size(); c++) {
+			if (route[c] == route[i]) {
+				continue;
+			}
+
+			const double distance = distance_from_start[c] - distance_from_start[i];
+			graph::Edge<double> edge{ ids[i],ids[c] - 1,(distance / settings_.bus_velocity) / SECONDS_IN_MINUTE,bus->name_id,static_cast<int>(c - i) };
+
+			// Of parallel rides (a stop repeated on the route or several buses between the same stops)
+			// only the cheapest one is kept, on a tie the earlier one stays
+			auto [it, inserted] = edge_index.emplace(std::pair{ edge.from, edge.to }, edges.size());
+			if (inserted) {
+				edges.push_back(std::move(edge));
+			}
+			else if (edge.weight < edges[it->second].weight) {
+				edges[it->second] = std::move(edge);
+			}
+		}
+	}
+}
+
+void router::TransportRouter::AddRoutePattern(const domain::Bus* bus, graph::VertexId first_vertex, std::vector<graph::Edge<double>>& edges) {
+	const auto& route = bus->route;
+	const std::vector<int> segments = catalogue_->GetRouteSegmentDistances(bus);
+
+	// Boarding and alighting take no time, the wait is spent on the stop's own wait edge.
+	// Both carry the bus name with zero span count, rides between neighbouring stops have span count 1.
+	for (size_t i = 0; i < route.size(); i++) {
+		const graph::VertexId stop_id = GetBoardVertex(route[i]);
+		const graph::VertexId vertex = first_vertex + i;
+
+		if (i > 0) {
+			edges.push_back({ vertex,stop_id - 1,0,bus->name_id,0 });
+		}
+		if (i + 1 < route.size()) {
+			edges.push_back({ stop_id,vertex,0,bus->name_id,0 });
+
+			const double distance = segments[i];
+			edges.push_back({ vertex,vertex + 1,(distance / settings_.bus_velocity) / SECONDS_IN_MINUTE,bus->name_id,1 });
+		}
+	}
+}
+
+void router::TransportRouter::InsertRouteVertices() {
+	if (settings_.graph_model != GraphModel::ROUTE_PATTERN) {
+		return;
+	}
+	for (size_t i = 0; i < base_bus_count_; i++) {
+		const auto& route = catalogue_->GetRoutes()[i]->route;
+		route_vertex_to_stop_.insert(route_vertex_to_stop_.end(), route.begin(), route.end());
+	}
+}
+
+void router::TransportRouter::AddFootpaths(std::vector<graph::Edge<double>>& edges) const {
+	if (!(settings_.footpath_radius > 0)) {
+		return;
+	}
+
+	// Neighbours of the stops are searched in parallel, their footpaths are appended in the order of stops
+	const auto& stops = catalogue_->GetStops();
+	std::vector<std::vector<graph::Edge<double>>> footpaths(stops.size());
+	parallel::ParallelFor(stops.size(), [&](size_t i) {
+		for (auto [stop, distance] : catalogue_->FindStopsWithinRadius(catalogue_->GetCoordinates(stops[i]), settings_.footpath_radius)) {
+			if (stop != stops[i]) {
+				footpaths[i].push_back({ GetWaitVertex(stops[i]),GetWaitVertex(stop),(distance / settings_.walk_velocity) / SECONDS_IN_MINUTE });
+			}
+		}
+	});
+	for (auto& stop_footpaths : footpaths) {
+		edges.insert(edges.end(), stop_footpaths.begin(), stop_footpaths.end());
+	}
+}
+
+bool router::TransportRouter::IsFootpath(const graph::Edge<double>& edge) const {
+	return edge.bus_name_id == domain::NO_NAME && GetVertexStop(edge.from) != GetVertexStop(edge.to);
+}
+
+double router::TransportRouter::GetFootpathDistance(const graph::Edge<double>& edge) const {
+	const geo::Coordinates from = catalogue_->GetCoordinates(GetVertexStop(edge.from));
+	const geo::Coordinates to = catalogue_->GetCoordinates(GetVertexStop(edge.to));
+	return geo::ChordToDistance(geo::ComputeSquaredChord(geo::ToUnitVector(from), geo::ToUnitVector(to)));
+}
+
+size_t router::TransportRouter::GetFootpathCount() const {
+	if (!graph_) {
+		return 0;
+	}
+	const auto& edges = graph_->GetEdges();
+	return std::count_if(edges.begin(), edges.end(), [this](const graph::Edge<double>& edge) {
+		return IsFootpath(edge);
+	});
+}
+
+void router::TransportRouter::BuildRouter() {
+	base_bus_count_ = catalogue_->GetRoutes().size();
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		raptor_router_ = std::make_unique<RaptorRouter>(*catalogue_, settings_);
+		return;
+	}
+
+	InsertRouteVertices();
+	stop_count_ = catalogue_->GetStops().size();
+	graph_ = std::make_unique<graph::DirectedWeightedGraph<double>>(graph::DirectedWeightedGraph<double>(stop_count_ * 2 + route_vertex_to_stop_.size()));
+
+	for (auto stop : catalogue_->GetStops()) {
+		graph_->AddEdge({ GetWaitVertex(stop),GetBoardVertex(stop),static_cast<double>(settings_.bus_wait_time) });
+	}
+
+	std::vector<graph::Edge<double>> bus_edges;
+	if (settings_.graph_model == GraphModel::ROUTE_PATTERN) {
+		graph::VertexId first_vertex = stop_count_ * 2;
+		for (auto& bus : catalogue_->GetRoutes()) {
+			AddRoutePattern(bus, first_vertex, bus_edges);
+			first_vertex += bus->route.size();
+		}
+	}
+	else {
+		EdgeIndex edge_index;
+		for (auto& bus : catalogue_->GetRoutes()) {
+			AddRoute(bus, bus_edges, edge_index);
+		}
+	}
+	AddFootpaths(bus_edges);
+	for (auto& edge : bus_edges) {
+		graph_->AddEdge(std::move(edge));
+	}
+	graph_->Freeze();
+	base_vertex_count_ = graph_->GetVertexCount();
+	base_edge_count_ = graph_->GetEdgeCount();
+	disruption_mask_ = graph::EdgeMask(graph_->GetEdgeCount());
+	removed_edges_ = graph::EdgeMask(graph_->GetEdgeCount());
+	if (settings_.integer_weights) {
+		BuildIntegerGraph();
+	}
+
+	BuildSearchRouters();
+	if (settings_.engine == RouterEngine::CONTRACTION_HIERARCHIES) {
+		ch_router_ = std::make_unique<graph::ContractionHierarchy<double>>(*graph_);
+	}
+	else if (settings_.engine == RouterEngine::FLOYD_WARSHALL && integer_graph_) {
+		integer_router_ = std::make_unique<graph::Router<uint32_t>>(*integer_graph_);
+	}
+	else if (settings_.engine == RouterEngine::FLOYD_WARSHALL) {
+		router_ = std::make_unique<graph::Router<double>>(graph::Router<double>(*graph_));
+	}
+}
+
+void router::TransportRouter::BuildSearchRouters() {
+	// Search trees (matrices, isochrones) and alternatives do not depend on the engine
+	dijkstra_router_ = std::make_unique<graph::DijkstraRouter<double>>(*graph_);
+	alternatives_router_ = std::make_unique<graph::KShortestPathsRouter<double>>(*graph_);
+	if (settings_.engine == RouterEngine::A_STAR) {
+		a_star_router_ = std::make_unique<graph::AStarRouter<double>>(*graph_, GetVertexCoordinates());
+	}
+	if (integer_graph_) {
+		integer_dijkstra_router_ = std::make_unique<graph::DijkstraRouter<uint32_t>>(*integer_graph_);
+	}
+}
+
+void router::TransportRouter::BuildIntegerGraph() {
+	integer_graph_ = std::make_unique<graph::DirectedWeightedGraph<uint32_t>>(graph_->GetVertexCount(), ToIntegerEdges(graph_->GetEdges()));
+	integer_graph_->Freeze();
+}
+
+std::vector<graph::Edge<uint32_t>> router::TransportRouter::ToIntegerEdges(const std::vector<graph::Edge<double>>& edges) const {
+	std::vector<graph::Edge<uint32_t>> result;
+	result.reserve(edges.size());
+	for (const auto& edge : edges) {
+		const double weight = std::round(edge.weight * MILLISECONDS_IN_MINUTE);
+		// Sums of two weights below half the range can not overflow in the table
+		if (!(weight < UINT32_MAX / 2)) {
+			throw std::out_of_range("Edge weight does not fit into integer milliseconds");
+		}
+		result.push_back({ edge.from,edge.to,static_cast<uint32_t>(weight),edge.bus_name_id,edge.span_count });
+	}
+	return result;
+}
+
+std::optional<graph::Router<double>::RouteInfo> router::TransportRouter::ToMinutes(const std::optional<graph::Router<uint32_t>::RouteInfo>& route) const {
+	if (!route) {
+		return std::nullopt;
+	}
+	graph::Router<double>::RouteInfo result{ 0,route->edges };
+	for (auto id : route->edges) {
+		result.weight += graph_->GetEdge(id).weight;
+	}
+	return result;
+}
+
+std::optional<graph::Router<double>::RouteInfo> router::TransportRouter::SearchRoute(graph::VertexId from, graph::VertexId to, graph::SearchStats* stats, const graph::EdgeMask* mask) const {
+	if (integer_dijkstra_router_) {
+		return ToMinutes(integer_dijkstra_router_->BuildRoute(from, to, stats, mask));
+	}
+	return dijkstra_router_->BuildRoute(from, to, stats, mask);
+}
+
+void router::TransportRouter::ApplyDelta(const RouterDelta& delta) {
+	std::unordered_set<const domain::Bus*> added_buses;
+	for (auto name : delta.added_buses) {
+		added_buses.insert(FindBus(name));
+	}
+	for (auto name : delta.removed_buses) {
+		removed_buses_.insert(FindBus(name));
+	}
+	for (auto bus : added_buses) {
+		removed_buses_.erase(bus);
+	}
+
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		raptor_router_ = std::make_unique<RaptorRouter>(*catalogue_, settings_, removed_buses_);
+		return;
+	}
+
+	// Buses riding over a changed distance get new edges in place of their present ones
+	std::set<std::pair<const domain::Stop*, const domain::Stop*>> changed_hops;
+	for (auto [from, to] : delta.changed_distances) {
+		changed_hops.insert({ catalogue_->FindStop(from),catalogue_->FindStop(to) });
+		changed_hops.insert({ catalogue_->FindStop(to),catalogue_->FindStop(from) });
+	}
+	std::unordered_set<const domain::Bus*> stale_buses(removed_buses_.begin(), removed_buses_.end());
+	std::unordered_set<const domain::Bus*> rebuilt_buses(added_buses);
+	for (auto bus : catalogue_->GetRoutes()) {
+		if (removed_buses_.count(bus) || added_buses.count(bus) || changed_hops.empty()) {
+			continue;
+		}
+		for (size_t i = 1; i < bus->route.size(); i++) {
+			if (changed_hops.count({ bus->route[i - 1],bus->route[i] })) {
+				stale_buses.insert(bus);
+				rebuilt_buses.insert(bus);
+				break;
+			}
+		}
+	}
+
+	std::unordered_set<domain::NameId> stale_names;
+	for (auto bus : stale_buses) {
+		stale_names.insert(bus->name_id);
+	}
+	const auto& edges = graph_->GetEdges();
+	std::vector<graph::EdgeId> removed;
+	for (graph::EdgeId id = 0; id < edges.size(); id++) {
+		if (!removed_edges_.IsDisabled(id) && stale_names.count(edges[id].bus_name_id)) {
+			removed.push_back(id);
+		}
+	}
+
+	std::vector<graph::Edge<double>> added_edges;
+	size_t vertex_count = graph_->GetVertexCount();
+	if (settings_.graph_model == GraphModel::ROUTE_PATTERN) {
+		for (auto bus : catalogue_->GetRoutes()) {
+			if (rebuilt_buses.count(bus)) {
+				AddRoutePattern(bus, vertex_count, added_edges);
+				vertex_count += bus->route.size();
+				route_vertex_to_stop_.insert(route_vertex_to_stop_.end(), bus->route.begin(), bus->route.end());
+			}
+		}
+	}
+	else {
+		// Only the cheapest ride between two stops is kept, so a removed ride may have hidden
+		// a ride of another bus between the same stops: such buses are generated again too
+		const auto by_name = [](const domain::Bus* lhs, const domain::Bus* rhs) {
+			return lhs->bus_name < rhs->bus_name;
+		};
+		for (auto id : removed) {
+			const auto& from_buses = catalogue_->GetStopBuses(GetVertexStop(edges[id].from));
+			const auto& to_buses = catalogue_->GetStopBuses(GetVertexStop(edges[id].to));
+			for (auto bus : from_buses) {
+				if (std::binary_search(to_buses.begin(), to_buses.end(), bus, by_name) && !removed_buses_.count(bus)) {
+					rebuilt_buses.insert(bus);
+				}
+			}
+		}
+
+		std::unordered_set<graph::EdgeId> removed_set(removed.begin(), removed.end());
+		EdgeIndex live_edges;
+		for (graph::EdgeId id = 0; id < edges.size(); id++) {
+			if (edges[id].bus_name_id != domain::NO_NAME && !removed_edges_.IsDisabled(id) && !removed_set.count(id)) {
+				live_edges.emplace(std::pair{ edges[id].from,edges[id].to }, id);
+			}
+		}
+
+		std::vector<graph::Edge<double>> candidates;
+		EdgeIndex candidate_index;
+		for (auto bus : catalogue_->GetRoutes()) {
+			if (rebuilt_buses.count(bus)) {
+				AddRoute(bus, candidates, candidate_index);
+			}
+		}
+		for (auto& edge : candidates) {
+			const auto live = live_edges.find({ edge.from,edge.to });
+			if (live == live_edges.end()) {
+				added_edges.push_back(std::move(edge));
+			}
+			else if (edge.weight < edges[live->second].weight) {
+				removed.push_back(live->second);
+				added_edges.push_back(std::move(edge));
+			}
+		}
+	}
+
+	for (const auto& edge : added_edges) {
+		added_route_bound_ = std::min(added_route_bound_, settings_.bus_wait_time + edge.weight);
+	}
+	const graph::EdgeId first_added = graph_->GetEdgeCount();
+	graph_->Extend(vertex_count, added_edges);
+	if (integer_graph_) {
+		integer_graph_->Extend(vertex_count, ToIntegerEdges(added_edges));
+	}
+	removed_edges_.Resize(graph_->GetEdgeCount());
+	disruption_mask_.Resize(graph_->GetEdgeCount());
+	for (auto id : removed) {
+		removed_edges_.Disable(id);
+		disruption_mask_.Disable(id);
+	}
+	// New rides through closed stops or of cancelled buses stay out of service
+	MarkDisruptions(disruptions_, disruption_mask_, first_added);
+	BuildSearchRouters();
+}
+
+const domain::Stop* router::TransportRouter::FindStop(std::string_view name) const {
+	const domain::Stop* stop = catalogue_->FindStop(name);
+	if (stop == nullptr) {
+		throw std::out_of_range("Unknown stop");
+	}
+	return stop;
+}
+
+const domain::Bus* router::TransportRouter::FindBus(std::string_view name) const {
+	const domain::Bus* bus = catalogue_->FindBusRoute(name);
+	if (bus == nullptr) {
+		throw std::out_of_range("Unknown bus");
+	}
+	return bus;
+}
+
+bool router::TransportRouter::IsRouteCurrent(const std::optional<graph::Router<double>::RouteInfo>& route) const {
+	if (!route) {
+		// Removing edges can not connect anything
+		return added_route_bound_ == std::numeric_limits<double>::infinity();
+	}
+	// A route through an added edge waits for a bus first, so cheaper routes can not use added edges
+	if (!(route->weight < added_route_bound_)) {
+		return false;
+	}
+	for (auto id : route->edges) {
+		if (removed_edges_.IsDisabled(id)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::optional<graph::Router<double>::RouteInfo> router::TransportRouter::BuildRoute(std::string_view from, std::string_view to, graph::SearchStats* stats, const Disruptions* disruptions) {
+	const graph::VertexId from_id = GetWaitVertex(FindStop(from));
+	const graph::VertexId to_id = GetWaitVertex(FindStop(to));
+
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		throw std::logic_error("The RAPTOR engine builds journeys, not graph routes");
+	}
+
+	graph::EdgeMask request_mask;
+	const graph::EdgeMask* mask = SelectMask(disruptions, request_mask);
+	if (settings_.engine == RouterEngine::A_STAR) {
+		return a_star_router_->BuildRoute(from_id, to_id, stats, mask);
+	}
+	if (settings_.engine == RouterEngine::DIJKSTRA || disruptions || has_disruptions_) {
+		return SearchRoute(from_id, to_id, stats, mask);
+	}
+
+	// After ApplyDelta the table and the hierarchy describe the old graph, only their stale routes are searched again
+	std::optional<graph::Router<double>::RouteInfo> route;
+	if (settings_.engine == RouterEngine::CONTRACTION_HIERARCHIES) {
+		route = ch_router_->BuildRoute(from_id, to_id);
+	}
+	else if (integer_router_) {
+		route = ToMinutes(integer_router_->BuildRoute(from_id, to_id));
+	}
+	else {
+		route = router_->BuildRoute(from_id, to_id);
+	}
+	if (!IsRouteCurrent(route)) {
+		return SearchRoute(from_id, to_id, stats, mask);
+	}
+	return route;
+}
+
+router::PointRoute router::TransportRouter::BuildRoute(geo::Coordinates from, geo::Coordinates to, double walk_velocity, const Disruptions* disruptions) const {
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		throw std::logic_error("Routes between points need a graph engine");
+	}
+	const auto walk = [walk_velocity](double distance) {
+		return WalkLeg{ distance,(distance / walk_velocity) / SECONDS_IN_MINUTE };
+	};
+
+	PointRoute result;
+	result.first_walk = walk(geo::ChordToDistance(geo::ComputeSquaredChord(geo::ToUnitVector(from), geo::ToUnitVector(to))));
+	result.total_time = result.first_walk.time;
+
+	const auto from_stops = catalogue_->FindNearestStops(from, ACCESS_STOP_COUNT);
+	const auto to_stops = catalogue_->FindNearestStops(to, ACCESS_STOP_COUNT);
+	std::vector<graph::EndpointLink<double>> sources;
+	for (auto [stop, distance] : from_stops) {
+		sources.push_back({ GetWaitVertex(stop),walk(distance).time });
+	}
+	std::vector<graph::EndpointLink<double>> targets;
+	for (auto [stop, distance] : to_stops) {
+		targets.push_back({ GetWaitVertex(stop),walk(distance).time });
+	}
+
+	graph::EdgeMask request_mask;
+	auto route = dijkstra_router_->BuildRoute(sources, targets, SelectMask(disruptions, request_mask));
+	if (!route || !(route->weight < result.total_time)) {
+		return result;
+	}
+
+	result.from_stop = from_stops[route->source].first;
+	result.to_stop = to_stops[route->target].first;
+	result.first_walk = walk(from_stops[route->source].second);
+	result.last_walk = walk(to_stops[route->target].second);
+	result.route.edges = std::move(route->edges);
+	for (auto id : result.route.edges) {
+		result.route.weight += graph_->GetEdge(id).weight;
+	}
+	result.total_time = result.first_walk.time + result.route.weight + result.last_walk.time;
+	return result;
+}
+
+std::vector<graph::Router<double>::RouteInfo> router::TransportRouter::BuildRoutes(std::string_view from, std::string_view to, size_t count, const Disruptions* disruptions) const {
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		throw std::logic_error("The RAPTOR engine builds journeys, not graph routes");
+	}
+	const graph::VertexId from_id = GetWaitVertex(FindStop(from));
+	const graph::VertexId to_id = GetWaitVertex(FindStop(to));
+	graph::EdgeMask request_mask;
+	return alternatives_router_->BuildRoutes(from_id, to_id, count, SelectMask(disruptions, request_mask));
+}
+
+void router::TransportRouter::SetDisruptions(const Disruptions& disruptions) {
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		throw std::logic_error("Disruptions need a graph engine");
+	}
+	disruption_mask_ = removed_edges_;
+	MarkDisruptions(disruptions, disruption_mask_);
+	has_disruptions_ = !disruptions.stops.empty() || !disruptions.buses.empty() || !disruptions.edges.empty();
+
+	disruptions_ = Disruptions{ {},{},disruptions.edges };
+	for (auto name : disruptions.stops) {
+		disruptions_.stops.push_back(FindStop(name)->Stop_name);
+	}
+	for (auto name : disruptions.buses) {
+		disruptions_.buses.push_back(FindBus(name)->bus_name);
+	}
+}
+
+void router::TransportRouter::MarkDisruptions(const Disruptions& disruptions, graph::EdgeMask& mask, graph::EdgeId first_edge) const {
+	std::vector<bool> closed_vertices(graph_->GetVertexCount(), false);
+	for (auto name : disruptions.stops) {
+		const domain::Stop* stop = FindStop(name);
+		closed_vertices[GetWaitVertex(stop)] = true;
+		closed_vertices[GetBoardVertex(stop)] = true;
+	}
+
+	std::unordered_set<domain::NameId> cancelled_buses;
+	for (auto name : disruptions.buses) {
+		cancelled_buses.insert(FindBus(name)->name_id);
+	}
+
+	if (!disruptions.stops.empty() || !cancelled_buses.empty()) {
+		const auto& edges = graph_->GetEdges();
+		for (graph::EdgeId id = first_edge; id < edges.size(); id++) {
+			if (closed_vertices[edges[id].from] || closed_vertices[edges[id].to] || cancelled_buses.count(edges[id].bus_name_id)) {
+				mask.Disable(id);
+			}
+		}
+	}
+	for (auto id : disruptions.edges) {
+		mask.Disable(id);
+	}
+}
+
+const graph::EdgeMask* router::TransportRouter::SelectMask(const Disruptions* disruptions, graph::EdgeMask& request_mask) const {
+	if (disruptions == nullptr) {
+		return disruption_mask_.IsEmpty() ? nullptr : &disruption_mask_;
+	}
+	request_mask = disruption_mask_;
+	MarkDisruptions(*disruptions, request_mask);
+	return request_mask.IsEmpty() ? nullptr : &request_mask;
+}
+
+std::vector<std::vector<std::optional<double>>> router::TransportRouter::BuildMatrix(const std::vector<std::string_view>& from, const std::vector<std::string_view>& to) const {
+	std::vector<std::vector<std::optional<double>>> result(from.size());
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		// Names are resolved before the workers start, so an unknown stop fails before any search runs
+		std::vector<const domain::Stop*> from_stops;
+		for (auto name : from) {
+			from_stops.push_back(FindStop(name));
+		}
+		std::vector<const domain::Stop*> to_stops;
+		for (auto name : to) {
+			to_stops.push_back(FindStop(name));
+		}
+		parallel::ParallelFor(from.size(), [&](size_t i) {
+			result[i] = raptor_router_->ComputeTimes(from_stops[i], to_stops);
+		});
+		return result;
+	}
+
+	std::vector<graph::VertexId> from_ids;
+	std::vector<graph::VertexId> to_ids;
+	for (auto name : from) {
+		from_ids.push_back(GetWaitVertex(FindStop(name)));
+	}
+	for (auto name : to) {
+		to_ids.push_back(GetWaitVertex(FindStop(name)));
+	}
+
+	if (router_ && disruption_mask_.IsEmpty() && added_route_bound_ == std::numeric_limits<double>::infinity()) {
+		parallel::ParallelFor(from.size(), [&](size_t i) {
+			result[i].reserve(to_ids.size());
+			for (auto to_id : to_ids) {
+				result[i].push_back(router_->GetWeight(from_ids[i], to_id));
+			}
+		});
+	}
+	else {
+		// Goal-directed and hierarchical queries serve one pair each, a plain search tree serves them all
+		graph::EdgeMask request_mask;
+		const graph::EdgeMask* mask = SelectMask(nullptr, request_mask);
+		parallel::ParallelFor(from.size(), [&](size_t i) {
+			result[i] = dijkstra_router_->ComputeWeights(from_ids[i], to_ids, mask);
+		});
+	}
+	return result;
+}
+
+std::vector<std::pair<const domain::Stop*, double>> router::TransportRouter::BuildIsochrone(std::string_view from, double max_time) const {
+	std::vector<std::pair<const domain::Stop*, double>> result;
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		const auto& stops = catalogue_->GetStops();
+		const auto times = raptor_router_->ComputeTimes(FindStop(from), stops);
+		for (size_t i = 0; i < stops.size(); i++) {
+			if (times[i] && *times[i] <= max_time) {
+				result.emplace_back(stops[i], *times[i]);
+			}
+		}
+		std::stable_sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+			return lhs.second < rhs.second;
+		});
+		return result;
+	}
+
+	// Stops are reached at their wait vertices, which the search settles in the order of time
+	graph::EdgeMask request_mask;
+	for (auto [vertex, time] : dijkstra_router_->ComputeReachable(GetWaitVertex(FindStop(from)), max_time, SelectMask(nullptr, request_mask))) {
+		if (vertex < stop_count_ * 2 && vertex % 2 == 0) {
+			result.emplace_back(GetVertexStop(vertex), time);
+		}
+	}
+	return result;
+}
+
+std::vector<router::Journey> router::TransportRouter::BuildJourneys(std::string_view from, std::string_view to) const {
+	if (settings_.engine != RouterEngine::RAPTOR) {
+		throw std::logic_error("Journeys are built by the RAPTOR engine only");
+	}
+	return raptor_router_->BuildJourneys(FindStop(from), FindStop(to));
+}
+
+std::vector<geo::Coordinates> router::TransportRouter::GetVertexCoordinates() const {
+	std::vector<geo::Coordinates> result(graph_->GetVertexCount());
+	const auto& coordinates = catalogue_->GetStopCoordinates();
+	for (size_t i = 0; i < stop_count_; i++) {
+		result[2 * i] = coordinates.Get(i);
+		result[2 * i + 1] = coordinates.Get(i);
+	}
+	const size_t first_vertex = stop_count_ * 2;
+	for (size_t i = 0; i < route_vertex_to_stop_.size(); i++) {
+		result[first_vertex + i] = coordinates.Get(route_vertex_to_stop_[i]->id);
+	}
+	return result;
+}
+
+const graph::Edge<double>& router::TransportRouter::GetEdge(graph::EdgeId id) const {
+	return graph_->GetEdge(id);
+}
+std::string_view router::TransportRouter::GetName(domain::NameId id) const {
+	return catalogue_->GetNames().GetName(id);
+}
+const domain::Stop* router::TransportRouter::GetVertexStop(graph::VertexId vertex) const {
+	if (vertex < stop_count_ * 2) {
+		return catalogue_->GetStops()[vertex / 2];
+	}
+	return route_vertex_to_stop_.at(vertex - stop_count_ * 2);
+}
+
+const graph::DirectedWeightedGraph<double>& router::TransportRouter::GetGraph() const {
+	return *graph_;
+}
+
+const graph::Router<double>& router::TransportRouter::GetRouter() const {
+	return *router_;
+}
+
+const graph::Router<uint32_t>& router::TransportRouter::GetIntegerRouter() const {
+	return *integer_router_;
+}
+
+const graph::ContractionHierarchy<double>& router::TransportRouter::GetContractionHierarchy() const {
+	return *ch_router_;
+}
+
+const router::RouterSettings& router::TransportRouter::GetRouterSettings() const {
+	return settings_;
+}
+
+bool router::TransportRouter::HasDelta() const {
+	return !removed_buses_.empty() || !removed_edges_.IsEmpty() || added_route_bound_ < std::numeric_limits<double>::infinity();
+}
+
+size_t router::TransportRouter::GetBaseVertexCount() const {
+	return base_vertex_count_;
+}
+
+size_t router::TransportRouter::GetBaseEdgeCount() const {
+	return base_edge_count_;
+}
+
+size_t router::TransportRouter::GetBaseBusCount() const {
+	return base_bus_count_;
+}
+
+const graph::EdgeMask& router::TransportRouter::GetRemovedEdges() const {
+	return removed_edges_;
+}
+
+std::vector<const domain::Bus*> router::TransportRouter::GetRemovedBuses() const {
+	std::vector<const domain::Bus*> result(removed_buses_.begin(), removed_buses_.end());
+	std::sort(result.begin(), result.end(), [](const domain::Bus* lhs, const domain::Bus* rhs) {
+		return lhs->id < rhs->id;
+	});
+	return result;
+}
+
+double router::TransportRouter::GetAddedRouteBound() const {
+	return added_route_bound_;
+}
+
+void router::TransportRouter::InsertSettings(const transport_router_serialize::TransportRouterDataBase& db) {
+	settings_.bus_velocity = db.settings().bus_velocity();
+	settings_.bus_wait_time = db.settings().bus_wait_time();
+	switch (db.settings().engine()) {
+	case transport_router_serialize::DIJKSTRA:
+		settings_.engine = RouterEngine::DIJKSTRA;
+		break;
+	case transport_router_serialize::CONTRACTION_HIERARCHIES:
+		settings_.engine = RouterEngine::CONTRACTION_HIERARCHIES;
+		break;
+	case transport_router_serialize::A_STAR:
+		settings_.engine = RouterEngine::A_STAR;
+		break;
+	case transport_router_serialize::RAPTOR:
+		settings_.engine = RouterEngine::RAPTOR;
+		break;
+	default:
+		settings_.engine = RouterEngine::FLOYD_WARSHALL;
+	}
+	settings_.graph_model = db.settings().graph_model() == transport_router_serialize::ROUTE_PATTERN ? GraphModel::ROUTE_PATTERN : GraphModel::SPAN_EDGES;
+	settings_.integer_weights = db.settings().integer_weights();
+	settings_.walk_velocity = db.settings().walk_velocity();
+	settings_.footpath_radius = db.settings().footpath_radius();
+}
+
+void router::TransportRouter::InsertIdsAndStops(const transport_router_serialize::TransportRouterDataBase& db) {
+	stop_count_ = catalogue_->GetStops().size();
+	base_bus_count_ = catalogue_->GetRoutes().size();
+	if (db.has_delta()) {
+		// Buses added by a delta follow the ones the graph was built from
+		if (db.delta().base_bus_count() < 0 || static_cast<size_t>(db.delta().base_bus_count()) > base_bus_count_) {
+			throw std::invalid_argument("Router delta does not match the catalogue");
+		}
+		base_bus_count_ = db.delta().base_bus_count();
+	}
+	InsertRouteVertices();
+}
+
+void router::TransportRouter::InsertRemovedBuses(const transport_router_serialize::TransportRouterDataBase& db) {
+	for (auto id : db.delta().removed_buses()) {
+		removed_buses_.insert(catalogue_->GetRoutes().at(id));
+	}
+}
+
+graph::Edge<double> router::TransportRouter::ParseEdge(const graph_serialize::Edge& edge) const {
+	graph::Edge<double> result;
+	result.from = edge.from();
+	result.to = edge.to();
+	result.weight = edge.weight();
+	if (edge.bus_name_case() == 5) {
+		result.bus_name_id = catalogue_->GetRoutes().at(edge.data())->name_id;
+	}
+	result.span_count = edge.span_count();
+	return result;
+}
+
+void router::TransportRouter::InsertGraph(const transport_router_serialize::TransportRouterDataBase& db, catalogue::TransportCatalogue& catalogue) {
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		return;
+	}
+
+	std::vector<graph::Edge<double>> edges;
+	edges.reserve(db.graph().edges__size());
+	for (auto& edge : db.graph().edges_()) {
+		edges.push_back(ParseEdge(edge));
+	}
+
+	graph_ = std::make_unique<graph::DirectedWeightedGraph<double>>(db.graph().vertex_count(), std::move(edges));
+	graph_->Freeze();
+	base_vertex_count_ = graph_->GetVertexCount();
+	base_edge_count_ = graph_->GetEdgeCount();
+	disruption_mask_ = graph::EdgeMask(graph_->GetEdgeCount());
+	removed_edges_ = graph::EdgeMask(graph_->GetEdgeCount());
+	if (settings_.integer_weights) {
+		BuildIntegerGraph();
+	}
+}
+
+void router::TransportRouter::InsertRouter(const transport_router_serialize::TransportRouterDataBase& db) {
+	if (settings_.engine == RouterEngine::RAPTOR) {
+		raptor_router_ = std::make_unique<RaptorRouter>(*catalogue_, settings_, removed_buses_);
+		return;
+	}
+
+	// The table and the hierarchy are checked against the graph they were built over, before the delta extends it
+	if (settings_.engine == RouterEngine::CONTRACTION_HIERARCHIES) {
+		ch_router_ = std::make_unique<graph::ContractionHierarchy<double>>(db.contraction_hierarchy(), *graph_);
+	}
+	else if (settings_.engine == RouterEngine::FLOYD_WARSHALL && integer_graph_) {
+		integer_router_ = std::make_unique<graph::Router<uint32_t>>(db.router(), *integer_graph_);
+	}
+	else if (settings_.engine == RouterEngine::FLOYD_WARSHALL) {
+		router_ = std::make_unique<graph::Router<double>>(graph::Router<double>(db.router(), *graph_));
+	}
+	InsertDelta(db);
+	BuildSearchRouters();
+}
+
+void router::TransportRouter::InsertDelta(const transport_router_serialize::TransportRouterDataBase& db) {
+	if (!db.has_delta()) {
+		return;
+	}
+	const auto& delta = db.delta();
+
+	std::vector<graph::Edge<double>> added_edges;
+	added_edges.reserve(delta.added_edges_size());
+	for (const auto& edge : delta.added_edges()) {
+		added_edges.push_back(ParseEdge(edge));
+	}
+	for (auto id : delta.route_vertex_stops()) {
+		route_vertex_to_stop_.push_back(catalogue_->GetStops().at(id));
+	}
+	const size_t vertex_count = stop_count_ * 2 + route_vertex_to_stop_.size();
+	if (delta.vertex_count() < 0 || static_cast<size_t>(delta.vertex_count()) != vertex_count) {
+		throw std::invalid_argument("Router delta does not match the graph");
+	}
+
+	graph_->Extend(vertex_count, added_edges);
+	if (integer_graph_) {
+		integer_graph_->Extend(vertex_count, ToIntegerEdges(added_edges));
+	}
+	removed_edges_.Resize(graph_->GetEdgeCount());
+	for (auto id : delta.removed_edges()) {
+		if (id >= graph_->GetEdgeCount()) {
+			throw std::invalid_argument("Router delta does not match the graph");
+		}
+		removed_edges_.Disable(id);
+	}
+	disruption_mask_ = removed_edges_;
+	added_route_bound_ = delta.added_route_bound();
+}
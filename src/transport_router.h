@@ -1,58 +1,207 @@
-#pragma once
-
-#include <map>
-#include <memory>
-#include <vector>
-
-#include "graph.h"
-#include "router.h"
-#include "json_builder.h"
-#include "transport_catalogue.h"
-#include "transport_router.pb.h"
-namespace router {
-
-	const int SECONDS_IN_MINUTE = 60;
-
-	struct RouterSettings
-	{
-		int bus_wait_time = 0;
-		double bus_velocity = 0;
-	};
-
-	class TransportRouter {
-	public:
-		TransportRouter() = default;
-
-		TransportRouter(RouterSettings settings, const catalogue::TransportCatalogue* catalogue)
-			:settings_(settings), catalogue_(catalogue)
-		{
-
-		}
-
-		TransportRouter(const transport_router_serialize::TransportRouterDataBase&, catalogue::TransportCatalogue& catalogue_);
-		void AddRoute(const domain::Bus*);
-		void BuildRouter();
-		std::optional<graph::Router<double>::RouteInfo> BuildRoute(std::string_view from, std::string_view to);
-		const graph::Edge<double>& GetEdge(graph::EdgeId) const;
-		const std::map<graph::VertexId, const domain::Stop*>& GetIdsToStops() const;
-
-		const graph::DirectedWeightedGraph<double>& GetGraph() const;
-		const graph::Router<double>& GetRouter() const;
-		const router::RouterSettings& GetRouterSettings() const;
-
-	private:
-		RouterSettings settings_;
-
-		std::map<graph::VertexId, const domain::Stop*> id_to_stop_;
-		std::map<const domain::Stop*, graph::VertexId> stop_to_id_;
-
-		const catalogue::TransportCatalogue* catalogue_ = nullptr;
-		std::unique_ptr <graph::DirectedWeightedGraph<double>> graph_ = nullptr;
-		std::unique_ptr<graph::Router<double>> router_ = nullptr;
-
-		void InsertSettings(const transport_router_serialize::TransportRouterDataBase&);
-		void InsertIdsAndStops(const transport_router_serialize::TransportRouterDataBase&);
-		void InsertGraph(const transport_router_serialize::TransportRouterDataBase&, catalogue::TransportCatalogue&);
-		void InsertRouter(const transport_router_serialize::TransportRouterDataBase&);
-	};
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "a_star_router.h"
+#include "contraction_hierarchy.h"
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "k_shortest_paths.h"
+#include "raptor_router.h"
+#include "router.h"
+#include "router_settings.h"
+#include "json_builder.h"
+#include "parallel.h"
+#include "transport_catalogue.h"
+#include "transport_router.pb.h"
+namespace router {
+
+	namespace detail {
+
+		struct VertexPairHasher {
+			size_t operator() (std::pair<graph::VertexId, graph::VertexId> pair) const {
+				return hasher(pair.first) * 37 + hasher(pair.second);
+			}
+			std::hash<graph::VertexId> hasher;
+		};
+	}
+
+	// Stops, buses and graph edges taken out of service. Buses still pass a closed stop,
+	// but nobody boards or alights there.
+	struct Disruptions {
+		std::vector<std::string_view> stops;
+		std::vector<std::string_view> buses;
+		std::vector<graph::EdgeId> edges;
+	};
+
+	// Changes of the catalogue since the router was built: the caller adds buses and sets
+	// distances in the catalogue first, removed buses stay there but are no longer served
+	struct RouterDelta {
+		std::vector<std::string_view> added_buses;
+		std::vector<std::string_view> removed_buses;
+		std::vector<std::pair<std::string_view, std::string_view>> changed_distances;
+	};
+
+	struct WalkLeg {
+		double distance = 0;
+		double time = 0;
+	};
+
+	// Trip between two points: a walk to a stop, a route over the graph to another stop and a walk
+	// from there. When walking all the way is fastest both stops are nullptr and only first_walk is set.
+	struct PointRoute {
+		double total_time = 0;
+		const domain::Stop* from_stop = nullptr;
+		const domain::Stop* to_stop = nullptr;
+		WalkLeg first_walk;
+		graph::Router<double>::RouteInfo route{ 0,{} };
+		WalkLeg last_walk;
+	};
+
+	class TransportRouter {
+	public:
+		TransportRouter() = default;
+
+		TransportRouter(RouterSettings settings, const catalogue::TransportCatalogue* catalogue)
+			:settings_(settings), catalogue_(catalogue)
+		{
+
+		}
+
+		TransportRouter(const transport_router_serialize::TransportRouterDataBase&, catalogue::TransportCatalogue& catalogue_);
+		using EdgeIndex = std::unordered_map<std::pair<graph::VertexId, graph::VertexId>, size_t, detail::VertexPairHasher>;
+
+		void AddRoute(const domain::Bus*, std::vector<graph::Edge<double>>& edges, EdgeIndex& edge_index);
+		void AddRoutePattern(const domain::Bus*, graph::VertexId first_vertex, std::vector<graph::Edge<double>>& edges);
+		void BuildRouter();
+		// Tombstones the edges of removed buses and of buses riding over a changed distance and appends
+		// the edges of added and changed buses. Routes of Floyd-Warshall and the hierarchy stay in use
+		// unless they run over a removed edge or could be beaten by an added one.
+		void ApplyDelta(const RouterDelta& delta);
+		// Disruptions of the request are added to the process-wide ones. While anything is disabled
+		// the table of Floyd-Warshall and the hierarchy can not be used and Dijkstra answers instead.
+		// stats counts the vertices settled by the search, zero when the route comes from the table or the hierarchy.
+		std::optional<graph::Router<double>::RouteInfo> BuildRoute(std::string_view from, std::string_view to, graph::SearchStats* stats = nullptr, const Disruptions* disruptions = nullptr);
+		// Walks at walk_velocity, in meters per second, to one of the stops nearest to from and from one of those
+		// nearest to to. One search joins them through virtual endpoints, the graph is left as it is; graph engines only
+		PointRoute BuildRoute(geo::Coordinates from, geo::Coordinates to, double walk_velocity, const Disruptions* disruptions = nullptr) const;
+		// Up to count distinct routes ordered by time, the first one is optimal; graph engines only
+		std::vector<graph::Router<double>::RouteInfo> BuildRoutes(std::string_view from, std::string_view to, size_t count, const Disruptions* disruptions = nullptr) const;
+		// Disruptions applied to every following search; graph engines only
+		void SetDisruptions(const Disruptions& disruptions);
+		// Travel times from every origin to every destination, nullopt where no route exists.
+		// One search tree per origin serves all destinations, origins are processed in parallel.
+		std::vector<std::vector<std::optional<double>>> BuildMatrix(const std::vector<std::string_view>& from, const std::vector<std::string_view>& to) const;
+		// Stops reachable from the stop within max_time minutes with their travel times, fastest first
+		std::vector<std::pair<const domain::Stop*, double>> BuildIsochrone(std::string_view from, double max_time) const;
+		// Available with the RAPTOR engine only, which builds no graph
+		std::vector<Journey> BuildJourneys(std::string_view from, std::string_view to) const;
+		const graph::Edge<double>& GetEdge(graph::EdgeId) const;
+		// Footpaths join the wait vertices of two stops, no bus rides them
+		bool IsFootpath(const graph::Edge<double>& edge) const;
+		// Length in meters of the footpath, the distance between its stops
+		double GetFootpathDistance(const graph::Edge<double>& edge) const;
+		size_t GetFootpathCount() const;
+		// Name of a stop or a bus, such as the bus_name_id of an edge
+		std::string_view GetName(domain::NameId) const;
+		// Stop of a stop vertex or of a ROUTE_PATTERN route vertex
+		const domain::Stop* GetVertexStop(graph::VertexId vertex) const;
+
+		const graph::DirectedWeightedGraph<double>& GetGraph() const;
+		const graph::Router<double>& GetRouter() const;
+		const graph::Router<uint32_t>& GetIntegerRouter() const;
+		const graph::ContractionHierarchy<double>& GetContractionHierarchy() const;
+		const router::RouterSettings& GetRouterSettings() const;
+		// True once ApplyDelta changed the router, the base then stores the delta next to the graph it was applied to
+		bool HasDelta() const;
+		// Size of the graph BuildRouter made and the number of buses it was made of. The table and the hierarchy
+		// describe this part, ApplyDelta appends to it.
+		size_t GetBaseVertexCount() const;
+		size_t GetBaseEdgeCount() const;
+		size_t GetBaseBusCount() const;
+		// Edges tombstoned and buses taken out of service by ApplyDelta, the buses ordered by id
+		const graph::EdgeMask& GetRemovedEdges() const;
+		std::vector<const domain::Bus*> GetRemovedBuses() const;
+		double GetAddedRouteBound() const;
+
+	private:
+		// Stops a trip between points may start or end at, nearest first
+		static constexpr size_t ACCESS_STOP_COUNT = 5;
+
+		RouterSettings settings_;
+
+		// Stop with id i owns the vertices 2i (waiting for a bus) and 2i + 1 (boarded)
+		size_t stop_count_ = 0;
+		size_t base_bus_count_ = 0;
+		size_t base_vertex_count_ = 0;
+		size_t base_edge_count_ = 0;
+		// Stops of the (bus, position) vertices of ROUTE_PATTERN, they follow the stop vertices.
+		// The first base_bus_count_ buses come first, ApplyDelta appends the vertices of rebuilt buses.
+		std::vector<const domain::Stop*> route_vertex_to_stop_;
+
+		const catalogue::TransportCatalogue* catalogue_ = nullptr;
+		std::unique_ptr <graph::DirectedWeightedGraph<double>> graph_ = nullptr;
+		std::unique_ptr<graph::Router<double>> router_ = nullptr;
+		std::unique_ptr<graph::DijkstraRouter<double>> dijkstra_router_ = nullptr;
+		std::unique_ptr<graph::ContractionHierarchy<double>> ch_router_ = nullptr;
+		std::unique_ptr<graph::AStarRouter<double>> a_star_router_ = nullptr;
+		std::unique_ptr<graph::KShortestPathsRouter<double>> alternatives_router_ = nullptr;
+		std::unique_ptr<RaptorRouter> raptor_router_ = nullptr;
+
+		// Copy of graph_ with the weights in milliseconds and the same edge ids, built with integer_weights
+		std::unique_ptr<graph::DirectedWeightedGraph<uint32_t>> integer_graph_ = nullptr;
+		std::unique_ptr<graph::Router<uint32_t>> integer_router_ = nullptr;
+		std::unique_ptr<graph::DijkstraRouter<uint32_t>> integer_dijkstra_router_ = nullptr;
+
+		// Edges disabled for the whole process, sized to the graph once it is built
+		graph::EdgeMask disruption_mask_;
+		bool has_disruptions_ = false;
+		// The disruptions behind disruption_mask_ with names viewing into the catalogue, ApplyDelta marks its new edges with them
+		Disruptions disruptions_;
+
+		// Edges tombstoned by ApplyDelta, always part of disruption_mask_
+		graph::EdgeMask removed_edges_;
+		std::unordered_set<const domain::Bus*> removed_buses_;
+		// No route using an edge added by ApplyDelta is faster than this
+		double added_route_bound_ = std::numeric_limits<double>::infinity();
+
+		std::vector<geo::Coordinates> GetVertexCoordinates() const;
+		// Disables the edges from first_edge on that the disruptions close, and the edges they list
+		void MarkDisruptions(const Disruptions& disruptions, graph::EdgeMask& mask, graph::EdgeId first_edge = 0) const;
+		// nullptr when nothing is disabled, otherwise the process mask or request_mask filled with it and the request's disruptions
+		const graph::EdgeMask* SelectMask(const Disruptions* disruptions, graph::EdgeMask& request_mask) const;
+		void InsertRouteVertices();
+		// Footpaths between stops within footpath_radius of each other, in both directions
+		void AddFootpaths(std::vector<graph::Edge<double>>& edges) const;
+		void BuildSearchRouters();
+		void BuildIntegerGraph();
+		std::vector<graph::Edge<uint32_t>> ToIntegerEdges(const std::vector<graph::Edge<double>>& edges) const;
+		// Route of the integer graph with its weight summed from the edges of graph_
+		std::optional<graph::Router<double>::RouteInfo> ToMinutes(const std::optional<graph::Router<uint32_t>::RouteInfo>& route) const;
+		std::optional<graph::Router<double>::RouteInfo> SearchRoute(graph::VertexId from, graph::VertexId to, graph::SearchStats* stats, const graph::EdgeMask* mask) const;
+		const domain::Stop* FindStop(std::string_view name) const;
+		const domain::Bus* FindBus(std::string_view name) const;
+		static graph::VertexId GetWaitVertex(const domain::Stop* stop) {
+			return 2 * static_cast<graph::VertexId>(stop->id);
+		}
+		static graph::VertexId GetBoardVertex(const domain::Stop* stop) {
+			return 2 * static_cast<graph::VertexId>(stop->id) + 1;
+		}
+		bool IsRouteCurrent(const std::optional<graph::Router<double>::RouteInfo>& route) const;
+
+		graph::Edge<double> ParseEdge(const graph_serialize::Edge& edge) const;
+		void InsertSettings(const transport_router_serialize::TransportRouterDataBase&);
+		void InsertIdsAndStops(const transport_router_serialize::TransportRouterDataBase&);
+		void InsertGraph(const transport_router_serialize::TransportRouterDataBase&, catalogue::TransportCatalogue&);
+		void InsertRouter(const transport_router_serialize::TransportRouterDataBase&);
+		// Removed buses are read before the routers are made, the rest of the delta once the table and the hierarchy are loaded
+		void InsertRemovedBuses(const transport_router_serialize::TransportRouterDataBase&);
+		void InsertDelta(const transport_router_serialize::TransportRouterDataBase&);
+	};
 }
\ No newline at end of file